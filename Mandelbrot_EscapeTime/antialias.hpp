@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef _ANTIALIAS_HPP
+#define _ANTIALIAS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***************************************************************
+
+						ANTIALIAS
+
+	Extra samples for the pixels of a render that sit on an edge,
+	where a count differs a lot from a neighbour's. The plotter's
+	antialias pass picks them and iterates each one at a jittered
+	grid of points inside it, image_handler's write_image then
+	gives them the average of the colours of those samples rather
+	than the colour of their centre. Every other pixel keeps its
+	single sample, so the cost follows the length of the edges
+	rather than the size of the image.
+
+****************************************************************/
+
+struct antialias_samples
+{
+	int per_pixel;					//Samples taken inside each of the pixels
+	std::vector<size_t> pixels;		//Index into the count buffer, in row order
+
+	//Sample k of pixels[n] is at k * pixels.size() + n. smooth is only filled
+	//when the render had smooth counts.
+	std::vector<uint32_t> counts;
+	std::vector<float> smooth;
+
+	antialias_samples() : per_pixel(0) {}
+};
+
+#endif
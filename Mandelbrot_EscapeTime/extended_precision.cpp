@@ -0,0 +1,82 @@
+/*
+	Picks the scalar type the pixels are iterated in for the extended precision path.
+*/
+
+#include "extended_precision.hpp"
+
+//Bits kept beyond the pixel spacing, the orbit loses a few to rounding on every iteration
+#define SCALAR_GUARD_BITS 16
+#define SCALAR_FLOAT_GUARD_BITS 8
+
+const char* scalar_type_name(scalar_type type)
+{
+	switch (type)
+	{
+	case SCALAR_AUTO:
+		return "auto";
+	case SCALAR_FLOAT:
+		return "float";
+	case SCALAR_DOUBLE:
+		return "double";
+	case SCALAR_LONG_DOUBLE:
+		return "long double";
+	case SCALAR_DOUBLE_DOUBLE:
+		return "double-double";
+	case SCALAR_FLOAT128:
+		return "float128";
+	default:
+		return "unknown";
+	}
+}
+
+int scalar_type_digits(scalar_type type)
+{
+	switch (type)
+	{
+	case SCALAR_FLOAT:
+		return std::numeric_limits<float>::digits;
+	case SCALAR_DOUBLE:
+		return std::numeric_limits<double>::digits;
+	case SCALAR_LONG_DOUBLE:
+		return std::numeric_limits<long double>::digits;
+	case SCALAR_DOUBLE_DOUBLE:
+		return 2 * std::numeric_limits<double>::digits;
+	case SCALAR_FLOAT128:
+#if defined(MANDEL_HAS_FLOAT128)
+		return 113;
+#else
+		return 0;
+#endif
+	default:
+		return 0;
+	}
+}
+
+scalar_type select_scalar_type(double step, double magnitude)
+{
+	//Cheapest first, long double is skipped where it's no wider than a double
+	const scalar_type candidates[] = { SCALAR_FLOAT, SCALAR_DOUBLE, SCALAR_LONG_DOUBLE, SCALAR_DOUBLE_DOUBLE,
+										SCALAR_FLOAT128 };
+
+	double bits = 0.0;
+	if (step > 0.0 && magnitude > step)
+	{
+		bits = std::log2(magnitude / step);
+	}
+
+	scalar_type widest = SCALAR_DOUBLE;
+	for (scalar_type type : candidates)
+	{
+		int digits = scalar_type_digits(type);
+		int guard = (SCALAR_FLOAT == type) ? SCALAR_FLOAT_GUARD_BITS : SCALAR_GUARD_BITS;
+		if (digits >= bits + guard)
+		{
+			return type;
+		}
+		if (digits > scalar_type_digits(widest))
+		{
+			widest = type;
+		}
+	}
+	return widest;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#ifndef _EXTENDED_PRECISION_HPP
+#define _EXTENDED_PRECISION_HPP
+
+#include <cmath>
+#include <limits>
+
+#include "fixed_point.hpp"
+
+/***************************************************************
+
+					EXTENDED PRECISION
+
+	Scalar types for zooms that are too deep for double but not
+	deep enough to need perturbation, roughly 1e-13 to 1e-30. The
+	pixel loop is instantiated once per type, so adding one only
+	needs the handful of operations escape_time_scalar uses.
+
+	double_double keeps a value as the unevaluated sum of two
+	doubles (hi + lo with |lo| <= ulp(hi) / 2), about 106 bits of
+	mantissa at hardware double speed. __float128 has 113 bits but
+	is done in software, so it is only picked when double_double
+	isn't quite enough. long double is x87 extended (64 bits) with
+	GCC on x86, but only a double with MSVC.
+
+	At the other end float is enough for overview frames and runs
+	twice as many pixels per vector, the plotter has its own loops
+	for that rather than going through escape_time_scalar.
+
+****************************************************************/
+
+#if defined(__SIZEOF_FLOAT128__) && !defined(__clang__)
+#define MANDEL_HAS_FLOAT128 1
+#endif
+
+//Which scalar the pixels are iterated in, SCALAR_AUTO picks the cheapest one
+//with enough bits for the pixel spacing
+enum scalar_type
+{
+	SCALAR_AUTO,
+	SCALAR_FLOAT,
+	SCALAR_DOUBLE,
+	SCALAR_LONG_DOUBLE,
+	SCALAR_DOUBLE_DOUBLE,
+	SCALAR_FLOAT128
+};
+
+//Readable name for logging
+const char* scalar_type_name(scalar_type type);
+
+//Mantissa bits of each type, 0 if this compiler doesn't have it
+int scalar_type_digits(scalar_type type);
+
+// The cheapest type that resolves pixels step apart at coordinates up to magnitude,
+// with some guard bits for the rounding that builds up along the orbit. float gets
+// fewer, it's only meant for overviews where a few boundary pixels can change.
+// Falls back on the most precise type available if none of them are enough.
+scalar_type select_scalar_type(double step, double magnitude);
+
+struct double_double
+{
+	double hi;
+	double lo;
+
+	double_double() : hi(0.0), lo(0.0) {}
+
+	double_double(double value) : hi(value), lo(0.0) {}
+
+	double_double(double high, double low) : hi(high), lo(low) {}
+};
+
+// a + b exactly as s + e
+inline void two_sum(double a, double b, double &s, double &e)
+{
+	s = a + b;
+	double bb = s - a;
+	e = (a - (s - bb)) + (b - bb);
+}
+
+// a * b exactly as p + e, Dekker's split when there is no fused multiply-add
+inline void two_prod(double a, double b, double &p, double &e)
+{
+	p = a * b;
+#if defined(__FMA__)
+	e = std::fma(a, b, -p);
+#else
+	const double split = 134217729.0;	//2^27 + 1
+	double ta = split * a;
+	double ah = ta - (ta - a);
+	double al = a - ah;
+	double tb = split * b;
+	double bh = tb - (tb - b);
+	double bl = b - bh;
+	e = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+#endif
+}
+
+inline double_double operator+(const double_double &a, const double_double &b)
+{
+	double s, e;
+	two_sum(a.hi, b.hi, s, e);
+	e += a.lo + b.lo;
+	double hi = s + e;
+	return double_double(hi, e - (hi - s));
+}
+
+inline double_double operator-(const double_double &a)
+{
+	return double_double(-a.hi, -a.lo);
+}
+
+inline double_double operator-(const double_double &a, const double_double &b)
+{
+	return a + (-b);
+}
+
+inline double_double operator*(const double_double &a, const double_double &b)
+{
+	double p, e;
+	two_prod(a.hi, b.hi, p, e);
+	e += a.hi * b.lo + a.lo * b.hi;
+	double hi = p + e;
+	return double_double(hi, e - (hi - p));
+}
+
+//Conversions used by the pixel loop, all of the types share one template
+inline double scalar_to_double(float value) { return value; }
+inline double scalar_to_double(double value) { return value; }
+inline double scalar_to_double(long double value) { return (double)value; }
+inline double scalar_to_double(const double_double &value) { return value.hi + value.lo; }
+#if defined(MANDEL_HAS_FLOAT128)
+inline double scalar_to_double(__float128 value) { return (double)value; }
+#endif
+
+// Value of a fixed point number in the given type, summed from the least significant
+// limb up so every step only drops bits the type can't hold anyway
+template <typename Scalar>
+Scalar scalar_from_fixed(const fixed_point &value)
+{
+	const Scalar limb_weight = Scalar(1.0 / 4294967296.0);
+	Scalar result = Scalar(0.0);
+	for (int k = value.num_limbs() - 1; k > 0; k--)
+	{
+		result = (result + Scalar((double)value.limb(k))) * limb_weight;
+	}
+	result = result + Scalar((double)value.limb(0));
+	return value.is_negative() ? Scalar(0.0) - result : result;
+}
+
+// escape_time for z^2 + c in any of the scalar types, z is left as the first point
+// outside the bailout for the smooth count. Same order of operations as
+// first_order_kernel, so the double instantiation gives the same counts.
+template <typename Scalar>
+inline int escape_time_scalar(const Scalar &cr, const Scalar &ci, int iter_max, double &zr_out, double &zi_out)
+{
+	Scalar zr = cr;
+	Scalar zi = ci;
+	int iter = 0;
+
+	while (scalar_to_double(zr * zr + zi * zi) < 4.0 && iter < iter_max)
+	{
+		Scalar zr2 = zr * zr;
+		Scalar zi2 = zi * zi;
+		zi = Scalar(2.0) * zr * zi + ci;
+		zr = zr2 - zi2 + cr;
+		iter++;
+	}
+
+	zr_out = scalar_to_double(zr);
+	zi_out = scalar_to_double(zi);
+	return iter;
+}
+
+#endif
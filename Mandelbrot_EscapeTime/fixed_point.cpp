@@ -0,0 +1,316 @@
+/*
+	Multi-limb fixed point arithmetic for the perturbation reference orbit.
+*/
+
+#include "fixed_point.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+fixed_point::fixed_point(int num_limbs)
+	: m_limbs((num_limbs < 2) ? 2 : num_limbs, 0), m_negative(false)
+{
+}
+
+int fixed_point::num_limbs(void) const
+{
+	return (int)m_limbs.size();
+}
+
+uint32_t fixed_point::limb(int k) const
+{
+	return m_limbs[k];
+}
+
+bool fixed_point::is_negative(void) const
+{
+	return m_negative;
+}
+
+bool fixed_point::is_zero(void) const
+{
+	for (size_t k = 0; k < m_limbs.size(); k++)
+	{
+		if (0 != m_limbs[k])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int fixed_point::compare_magnitude(const fixed_point &other) const
+{
+	for (size_t k = 0; k < m_limbs.size(); k++)
+	{
+		if (m_limbs[k] != other.m_limbs[k])
+		{
+			return (m_limbs[k] < other.m_limbs[k]) ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+void fixed_point::add_magnitude(const fixed_point &other)
+{
+	uint64_t carry = 0;
+	for (size_t k = m_limbs.size(); k-- > 0;)
+	{
+		uint64_t sum = (uint64_t)m_limbs[k] + other.m_limbs[k] + carry;
+		m_limbs[k] = (uint32_t)sum;
+		carry = sum >> 32;
+	}
+}
+
+void fixed_point::subtract_magnitude(const fixed_point &other)
+{
+	uint64_t borrow = 0;
+	for (size_t k = m_limbs.size(); k-- > 0;)
+	{
+		uint64_t subtrahend = (uint64_t)other.m_limbs[k] + borrow;
+		borrow = ((uint64_t)m_limbs[k] < subtrahend) ? 1 : 0;
+		m_limbs[k] = (uint32_t)((uint64_t)m_limbs[k] + (borrow << 32) - subtrahend);
+	}
+}
+
+void fixed_point::divide_small(uint32_t divisor)
+{
+	uint64_t remainder = 0;
+	for (size_t k = 0; k < m_limbs.size(); k++)
+	{
+		uint64_t current = (remainder << 32) | m_limbs[k];
+		m_limbs[k] = (uint32_t)(current / divisor);
+		remainder = current % divisor;
+	}
+}
+
+bool fixed_point::from_string(const string &text, int num_limbs, fixed_point &result)
+{
+	size_t pos = 0;
+	while (pos < text.size() && isspace((unsigned char)text[pos]))
+	{
+		pos++;
+	}
+
+	bool negative = false;
+	if (pos < text.size() && ('-' == text[pos] || '+' == text[pos]))
+	{
+		negative = ('-' == text[pos]);
+		pos++;
+	}
+
+	//Collect the digits and remember where the decimal point was
+	string digits;
+	int point = -1;
+	for (; pos < text.size(); pos++)
+	{
+		char ch = text[pos];
+		if (isdigit((unsigned char)ch))
+		{
+			digits += ch;
+		}
+		else if ('.' == ch && point < 0)
+		{
+			point = (int)digits.size();
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (digits.empty())
+	{
+		return false;
+	}
+	if (point < 0)
+	{
+		point = (int)digits.size();
+	}
+
+	//Optional exponent just moves the decimal point
+	if (pos < text.size() && ('e' == text[pos] || 'E' == text[pos]))
+	{
+		pos++;
+		size_t exp_start = pos;
+		if (pos < text.size() && ('-' == text[pos] || '+' == text[pos]))
+		{
+			pos++;
+		}
+		if (pos >= text.size() || !isdigit((unsigned char)text[pos]))
+		{
+			return false;
+		}
+		while (pos < text.size() && isdigit((unsigned char)text[pos]))
+		{
+			pos++;
+		}
+		point += atoi(text.substr(exp_start, pos - exp_start).c_str());
+	}
+	while (pos < text.size() && isspace((unsigned char)text[pos]))
+	{
+		pos++;
+	}
+	if (pos != text.size())
+	{
+		return false;
+	}
+
+	if (point < 0)
+	{
+		digits.insert(0, (size_t)(-point), '0');
+		point = 0;
+	}
+	else if (point > (int)digits.size())
+	{
+		digits.append(point - digits.size(), '0');
+	}
+
+	//Fraction from the least significant digit up, frac = (digit + frac) / 10, with
+	//a guard limb so the rounding in the divisions doesn't reach the last real limb
+	fixed_point fraction(num_limbs + 1);
+	for (size_t d = digits.size(); d-- > (size_t)point;)
+	{
+		fraction.m_limbs[0] += (uint32_t)(digits[d] - '0');
+		fraction.divide_small(10);
+	}
+
+	uint32_t integer = 0;
+	for (int d = 0; d < point; d++)
+	{
+		integer = integer * 10 + (uint32_t)(digits[d] - '0');
+	}
+
+	result = fixed_point(num_limbs);
+	result.m_limbs[0] = integer;
+	for (int k = 1; k < result.num_limbs(); k++)
+	{
+		result.m_limbs[k] = fraction.m_limbs[k];
+	}
+	result.m_negative = negative && !result.is_zero();
+	return true;
+}
+
+fixed_point fixed_point::from_double(double value, int num_limbs)
+{
+	fixed_point result(num_limbs);
+	double magnitude = fabs(value);
+	double integer = floor(magnitude);
+	result.m_limbs[0] = (uint32_t)integer;
+
+	//Multiplying by 2^32 is exact, so this peels the mantissa off 32 bits at a time
+	double fraction = magnitude - integer;
+	for (int k = 1; k < num_limbs && fraction > 0.0; k++)
+	{
+		fraction = ldexp(fraction, 32);
+		double limb = floor(fraction);
+		result.m_limbs[k] = (uint32_t)limb;
+		fraction -= limb;
+	}
+	result.m_negative = (value < 0.0) && !result.is_zero();
+	return result;
+}
+
+double fixed_point::to_double(void) const
+{
+	//Past the third limb nothing is left that a double could hold
+	double value = 0.0;
+	size_t last = (m_limbs.size() < 4) ? m_limbs.size() : 4;
+	for (size_t k = last; k-- > 0;)
+	{
+		value = ldexp(value, -32) + (double)m_limbs[k];
+	}
+	return m_negative ? -value : value;
+}
+
+fixed_point& fixed_point::operator+=(const fixed_point &other)
+{
+	if (m_negative == other.m_negative)
+	{
+		add_magnitude(other);
+	}
+	else if (compare_magnitude(other) >= 0)
+	{
+		subtract_magnitude(other);
+	}
+	else
+	{
+		fixed_point larger(other);
+		larger.subtract_magnitude(*this);
+		*this = larger;
+	}
+	if (is_zero())
+	{
+		m_negative = false;
+	}
+	return *this;
+}
+
+fixed_point& fixed_point::operator-=(const fixed_point &other)
+{
+	fixed_point negated(other);
+	negated.m_negative = !other.m_negative && !other.is_zero();
+	return *this += negated;
+}
+
+fixed_point fixed_point::operator+(const fixed_point &other) const
+{
+	fixed_point result(*this);
+	result += other;
+	return result;
+}
+
+fixed_point fixed_point::operator-(const fixed_point &other) const
+{
+	fixed_point result(*this);
+	result -= other;
+	return result;
+}
+
+fixed_point fixed_point::operator*(const fixed_point &other) const
+{
+	//Schoolbook product, full[p] has weight 2^-32(p - 1) and full[0] is whatever
+	//overflowed the integer limb. Rows run from the least significant limb of this
+	//so every full[i] is still untouched when its row sets it to the final carry.
+	size_t n = m_limbs.size();
+	vector<uint32_t> full(2 * n, 0);
+	for (size_t i = n; i-- > 0;)
+	{
+		uint64_t carry = 0;
+		for (size_t j = n; j-- > 0;)
+		{
+			uint64_t t = (uint64_t)m_limbs[i] * other.m_limbs[j] + full[i + j + 1] + carry;
+			full[i + j + 1] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		full[i] = (uint32_t)carry;
+	}
+
+	fixed_point result((int)n);
+	for (size_t k = 0; k < n; k++)
+	{
+		result.m_limbs[k] = full[k + 1];
+	}
+	result.m_negative = (m_negative != other.m_negative) && !result.is_zero();
+	return result;
+}
+
+fixed_point fixed_point::twice(void) const
+{
+	fixed_point result(*this);
+	result.add_magnitude(*this);
+	return result;
+}
+
+int fixed_point::limbs_for_resolution(double step)
+{
+	//64 bits beyond the pixel spacing, plus the integer limb and one spare
+	double bits = 64.0;
+	if (step > 0.0 && step < 1.0)
+	{
+		bits -= log2(step);
+	}
+	return 2 + (int)ceil(bits / 32.0);
+}
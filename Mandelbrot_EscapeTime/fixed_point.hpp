@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef _FIXED_POINT_HPP
+#define _FIXED_POINT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***************************************************************
+
+						FIXED_POINT
+
+	Signed multi-limb fixed point number for the perturbation
+	reference orbit. Limb 0 is the integer part and each further
+	limb holds the next 32 bits of the fraction, so a number with
+	n limbs is exact to 2^-32(n-1). Values only ever need to reach
+	a few times the bailout radius, there's no exponent and the
+	integer part simply wraps if it overflows.
+
+	Every operand of an operation has to have the same number of
+	limbs, the precision is fixed once for the whole render.
+
+****************************************************************/
+
+class fixed_point
+{
+private:
+
+	//Magnitude, most significant limb first
+	std::vector<uint32_t> m_limbs;
+	bool m_negative;
+
+	//|this| compared with |other|, -1, 0 or 1
+	int compare_magnitude(const fixed_point &other) const;
+
+	//Magnitude arithmetic, ignoring the signs
+	void add_magnitude(const fixed_point &other);
+
+	//Requires |this| >= |other|
+	void subtract_magnitude(const fixed_point &other);
+
+	void divide_small(uint32_t divisor);
+
+	bool is_zero(void) const;
+
+public:
+
+	//Zero with the given number of limbs (at least 2)
+	explicit fixed_point(int num_limbs = 2);
+
+	//Parses a decimal string such as "-0.35751234567890123456789", anything past the
+	//precision of num_limbs is truncated. Returns false if it isn't a number.
+	static bool from_string(const std::string &text, int num_limbs, fixed_point &result);
+
+	//Exact as long as the value isn't smaller than the last limb
+	static fixed_point from_double(double value, int num_limbs);
+
+	double to_double(void) const;
+
+	int num_limbs(void) const;
+
+	//Limb 0 is the integer part, the sign is kept separately
+	uint32_t limb(int k) const;
+
+	bool is_negative(void) const;
+
+	fixed_point operator+(const fixed_point &other) const;
+
+	fixed_point operator-(const fixed_point &other) const;
+
+	//Truncated to num_limbs
+	fixed_point operator*(const fixed_point &other) const;
+
+	fixed_point& operator+=(const fixed_point &other);
+
+	fixed_point& operator-=(const fixed_point &other);
+
+	//Multiply by 2, cheaper than the full product
+	fixed_point twice(void) const;
+
+	//Number of limbs needed to resolve steps of the given size with some headroom
+	//for the reference orbit to lose precision over many iterations
+	static int limbs_for_resolution(double step);
+};
+
+#endif
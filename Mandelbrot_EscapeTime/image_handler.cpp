@@ -2,13 +2,47 @@
 #include <cmath>
 #include <iostream>
 
+//BMP headers, see begin_stream
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_INFO_HEADER_SIZE 40
+
+//Entries per whole iteration in the smooth palette, and a cap on its size so a
+//very large max_iter doesn't turn it into the biggest thing in memory
+#define SMOOTH_PALETTE_STEPS 16
+#define SMOOTH_PALETTE_MAX_ENTRIES (1 << 20)
+
 image_handler::image_handler(string filename, int max_iter, int dimension_x, int dimension_y)
+	: image_handler(filename, max_iter, dimension_x, dimension_y, false)
+{
+}
+
+image_handler::image_handler(string filename, int max_iter, int dimension_x, int dimension_y, bool streaming)
+	:	m_streaming(streaming),
+		m_width(dimension_x),
+		m_height(dimension_y),
+		m_row_size(0)
 {
 	if (!filename.empty())
 	{
 		m_filename = filename;
 	}
 	m_max_iter = max_iter;
+	m_smooth_scale = 0.0;
+	m_simd_level = detect_simd_level();
+
+	build_palette();
+
+#ifdef USING_OCV
+	m_img_mat = nullptr;
+#else
+	m_img_bmp = nullptr;
+#endif
+
+	//Nothing to allocate, the bands are coloured one row at a time
+	if (m_streaming)
+	{
+		return;
+	}
 
 	try {
 #ifdef USING_OCV
@@ -55,6 +89,56 @@ int image_handler::set_filename(string filename)
 	return -1;
 }
 
+int image_handler::reset(string filename, int max_iter, int dimension_x, int dimension_y)
+{
+	if (m_streaming)
+	{
+		cout << "Error: a streaming image_handler can't be reset" << endl;
+		return -1;
+	}
+	set_filename(filename);
+
+	if (max_iter != m_max_iter)
+	{
+		m_max_iter = max_iter;
+		build_palette();
+		//Rebuilt on the next smooth write, it's scaled to the cap
+		m_smooth_palette.clear();
+		m_smooth_scale = 0.0;
+	}
+
+	if (dimension_x != m_width || dimension_y != m_height)
+	{
+		m_width = dimension_x;
+		m_height = dimension_y;
+		try {
+#ifdef USING_OCV
+			if (nullptr != m_img_mat)
+			{
+				delete m_img_mat;
+			}
+			m_img_mat = new Mat(dimension_x, dimension_y, CV_8UC3);
+#else
+			//Every pixel is written by write_image, so the old contents don't need clearing
+			if (nullptr == m_img_bmp)
+			{
+				m_img_bmp = new bitmap_image(dimension_x, dimension_y);
+			}
+			else
+			{
+				m_img_bmp->setwidth_height(dimension_x, dimension_y);
+			}
+#endif
+		}
+		catch (std::exception &e)
+		{
+			cout << "Exception during image_handler reset: " << e.what() << endl;
+			return -1;
+		}
+	}
+	return 0;
+}
+
 /*
 	This uses a slightly modified version of a bernstein polynomial to determine the RGB spectrum.
 	By using this polynomial, we map the number of iterations on a continous [0...1] scale giving a
@@ -63,10 +147,10 @@ int image_handler::set_filename(string filename)
 	g(t)=15*(1−t)^2*t^2
 	b(t)=8.5*(1−t)^3*t
 */
-RGB_T image_handler::get_smooth_RGB_from_iter(int iterations)
+RGB_T image_handler::get_smooth_RGB_from_iter(double iterations)
 {
 	//First we need to map the iterations from 0..1
-	double t = (double)iterations / (double)m_max_iter;
+	double t = iterations / (double)m_max_iter;
 
 	//then we apply these in our polynomials
 	uint8_t r = (uint8_t)(9 * (1 - t)*pow(t, 3) * 255); //And of course multiply by the max value of a single channel 
@@ -76,24 +160,209 @@ RGB_T image_handler::get_smooth_RGB_from_iter(int iterations)
 	return std::make_tuple(r, g, b);
 }
 
+void image_handler::set_simd_level(simd_level level)
+{
+	m_simd_level = (level > detect_simd_level()) ? detect_simd_level() : level;
+}
+
+//0x00RRGGBB, so in memory the bytes are in the bitmap's B, G, R order
+static inline uint32_t pack_palette_entry(const RGB_T &rgb)
+{
+	return (uint32_t)get<2>(rgb) | ((uint32_t)get<1>(rgb) << 8) | ((uint32_t)get<0>(rgb) << 16);
+}
+
+static inline void unpack_palette_entry(uint32_t entry, unsigned char *bgr)
+{
+	bgr[0] = (unsigned char)(entry & 0xFF);
+	bgr[1] = (unsigned char)((entry >> 8) & 0xFF);
+	bgr[2] = (unsigned char)((entry >> 16) & 0xFF);
+}
+
+void image_handler::build_palette(void)
+{
+	m_palette.resize((size_t)m_max_iter + 1);
+	for (int n = 0; n <= m_max_iter; n++)
+	{
+		m_palette[n] = pack_palette_entry(get_smooth_RGB_from_iter(n));
+	}
+}
 
-int image_handler::write_image(window<int>& screen, vector<int>& colours)
+void image_handler::build_smooth_palette(void)
+{
+	if (!m_smooth_palette.empty())
+	{
+		return;
+	}
+
+	size_t steps = (size_t)m_max_iter * SMOOTH_PALETTE_STEPS;
+	if (steps > SMOOTH_PALETTE_MAX_ENTRIES)
+	{
+		steps = SMOOTH_PALETTE_MAX_ENTRIES;
+	}
+	m_smooth_scale = (double)steps / m_max_iter;
+
+	m_smooth_palette.resize(steps + 1);
+	for (size_t i = 0; i <= steps; i++)
+	{
+		m_smooth_palette[i] = pack_palette_entry(get_smooth_RGB_from_iter(i / m_smooth_scale));
+	}
+}
+
+template <typename CountT>
+void image_handler::colour_row(const CountT *counts, const float *smooth, int width, unsigned char *bgr)
+{
+	//The vector loop does all but the last few pixels
+	if (NULL != smooth)
+	{
+		const long last = (long)m_smooth_palette.size() - 1;
+		int x = simd_colour_smooth_span(m_simd_level, smooth, width, m_smooth_scale, &m_smooth_palette[0], (int)last, bgr);
+		for (; x < width; ++x)
+		{
+			//Nearest entry, the first few iterations can give slightly negative values
+			long i = (long)(smooth[x] * m_smooth_scale + 0.5);
+			i = (i < 0) ? 0 : ((i > last) ? last : i);
+			unpack_palette_entry(m_smooth_palette[i], bgr + 3 * x);
+		}
+	}
+	else
+	{
+		int x = simd_colour_span(m_simd_level, counts, width, &m_palette[0], m_max_iter, bgr);
+		for (; x < width; ++x)
+		{
+			size_t n = ((size_t)counts[x] < (size_t)m_max_iter) ? (size_t)counts[x] : (size_t)m_max_iter;
+			unpack_palette_entry(m_palette[n], bgr + 3 * x);
+		}
+	}
+}
+
+
+// Each channel is averaged on its own, in the palette's 8 bit values
+void image_handler::apply_antialias(window<int>& screen, const antialias_samples& samples)
+{
+#ifdef USING_OCV
+	cout << "Error: antialiasing is only supported for bitmaps" << endl;
+#else
+	const size_t num_pixels = samples.pixels.size();
+	const bool smooth = !samples.smooth.empty();
+	const int width = screen.width();
+	if (0 >= samples.per_pixel || samples.counts.size() != num_pixels * samples.per_pixel)
+	{
+		return;
+	}
+	//The image itself may have been coloured from the integer counts
+	if (smooth)
+	{
+		build_smooth_palette();
+	}
+	const long last = (long)m_smooth_palette.size() - 1;
+
+#pragma omp parallel for schedule(static)
+	for (long long n = 0; n < (long long)num_pixels; ++n)
+	{
+		unsigned int sum[3] = { 0, 0, 0 };
+		for (int k = 0; k < samples.per_pixel; ++k)
+		{
+			size_t sample = (size_t)k * num_pixels + n;
+			uint32_t entry;
+			if (smooth)
+			{
+				long i = (long)(samples.smooth[sample] * m_smooth_scale + 0.5);
+				entry = m_smooth_palette[(i < 0) ? 0 : ((i > last) ? last : i)];
+			}
+			else
+			{
+				entry = m_palette[(samples.counts[sample] < (uint32_t)m_max_iter) ? samples.counts[sample] : m_max_iter];
+			}
+			sum[0] += entry & 0xFF;
+			sum[1] += (entry >> 8) & 0xFF;
+			sum[2] += (entry >> 16) & 0xFF;
+		}
+
+		int x = (int)(samples.pixels[n] % width);
+		int y = (int)(samples.pixels[n] / width);
+		unsigned char *bgr = m_img_bmp->row(y + screen.get_y_min()) + 3 * (x + screen.get_x_min());
+		for (int c = 0; c < 3; ++c)
+		{
+			bgr[c] = (unsigned char)((sum[c] + samples.per_pixel / 2) / samples.per_pixel);
+		}
+	}
+#endif
+}
+
+template <typename CountT>
+int image_handler::write_image(window<int>& screen, vector<CountT>& colours, const vector<float>* smooth,
+							   const antialias_samples* samples)
 {
 	int success = -1;
+	const int width = screen.width();
+	const int height = screen.height();
+	const float *smooth_data = (NULL != smooth) ? &(*smooth)[0] : NULL;
+	if (NULL != smooth)
+	{
+		build_smooth_palette();
+	}
+
 #ifdef USING_OCV
-	int k = 0;
-	for (int y = screen.get_y_min(); y < screen.get_y_max(); ++y)
+	vector<unsigned char> bgr((size_t)3 * width);
+	for (int y = 0; y < height; ++y)
 	{
-		for (int x = screen.get_x_min(); x < screen.get_x_max(); ++x)
+		size_t k = (size_t)y * width;
+		colour_row(&colours[k], (NULL != smooth_data) ? smooth_data + k : NULL, width, &bgr[0]);
+		for (int x = 0; x < width; ++x)
 		{
-			//Convert from our own RGB tuple to the opencv Vec3b 
-			//which is just a vector of uint8_t's
-			RGB_T rgb = get_smooth_RGB_from_iter(colours[k]);
-			Vec3b ocv_rgb(get<0>(rgb), get<1>(rgb), get<2>(rgb));
+			//Our palette is stored in bitmap order, the opencv Vec3b gets r, g, b
+			Vec3b ocv_rgb(bgr[3 * x + 2], bgr[3 * x + 1], bgr[3 * x + 0]);
 			//Then set the RGB values at each pixel
-			m_img_mat->at<Vec3b>(Point(x, y)) = ocv_rgb;
+			m_img_mat->at<Vec3b>(Point(x + screen.get_x_min(), y + screen.get_y_min())) = ocv_rgb;
 		}
 	}
+	success = save_image();
+
+#else
+	//Every row is independent, and the palette is already in the bitmap's BGR layout
+	//so each one is written straight into the image data
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; ++y)
+	{
+		size_t k = (size_t)y * width;
+		unsigned char *row = m_img_bmp->row(y + screen.get_y_min()) + 3 * screen.get_x_min();
+		colour_row(&colours[k], (NULL != smooth_data) ? smooth_data + k : NULL, width, row);
+	}
+	if (NULL != samples)
+	{
+		apply_antialias(screen, *samples);
+	}
+	success = save_image();
+#endif
+	return success;
+}
+
+template <typename CountT>
+void image_handler::colour_tile(int x_begin, int y_begin, int width, int height, const CountT *counts,
+								const float *smooth)
+{
+#ifdef USING_OCV
+	cout << "Error: colour_tile is only supported for bitmaps" << endl;
+#else
+	if (NULL != smooth)
+	{
+		//Tiles arrive from several threads at once, only one of them builds it
+#pragma omp critical (image_handler_smooth_palette)
+		build_smooth_palette();
+	}
+
+	for (int y = 0; y < height; ++y)
+	{
+		size_t k = (size_t)y * width;
+		colour_row(counts + k, (NULL != smooth) ? smooth + k : NULL, width, m_img_bmp->row(y_begin + y) + 3 * x_begin);
+	}
+#endif
+}
+
+int image_handler::save_image(void)
+{
+	int success = -1;
+#ifdef USING_OCV
 	try {
 		if (imwrite(m_filename, *m_img_mat))
 		{
@@ -104,24 +373,14 @@ int image_handler::write_image(window<int>& screen, vector<int>& colours)
 	{
 		cout << "Exception during image_handler construction: " << e.what() << endl;
 	}
-
 #else
-	int k = 0;
-	for (int y = screen.get_y_min(); y < screen.get_y_max(); ++y)
+	//bitmap_image's headers would wrap the same way
+	if (!fits_bmp(m_width, m_height))
 	{
-		for (int x = screen.get_x_min(); x < screen.get_x_max(); ++x)
-		{
-			//Convert from our own RGB tuple to the bmp image version
-			RGB_T rgb = get_smooth_RGB_from_iter(colours[k]);
-			rgb_t rgb_bmp;
-			rgb_bmp.red = get<0>(rgb);
-			rgb_bmp.green = get<1>(rgb);
-			rgb_bmp.blue = get<2>(rgb);
-			//Then set the RGB values at each pixel
-			m_img_bmp->set_pixel(x, y, rgb_bmp);
-			k++;
+		cout << "Error: a " << m_width << " x " << m_height << " bitmap would be "
+			 << bmp_file_size(m_width, m_height) << " bytes, BMP stops at 4 GiB, not written" << endl;
+		return -1;
 	}
-}
 	try {
 		cout << "Writing bitmap to: " << m_filename << endl;
 		m_img_bmp->save_image(m_filename);
@@ -136,6 +395,154 @@ int image_handler::write_image(window<int>& screen, vector<int>& colours)
 	return success;
 }
 
+//Little endian regardless of the host, which is what the BMP format wants
+static void write_le(ofstream &stream, unsigned int value, int bytes)
+{
+	for (int b = 0; b < bytes; b++)
+	{
+		stream.put((char)((value >> (8 * b)) & 0xFF));
+	}
+}
+
+uint64_t image_handler::bmp_file_size(int dimension_x, int dimension_y)
+{
+	//Same 24 bit layout as bitmap_image::save_image, rows padded to 4 bytes
+	uint64_t row_size = ((uint64_t)3 * dimension_x + 3) & ~(uint64_t)3;
+	return row_size * (uint64_t)dimension_y + BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE;
+}
+
+bool image_handler::fits_bmp(int dimension_x, int dimension_y)
+{
+	return bmp_file_size(dimension_x, dimension_y) <= UINT32_MAX;
+}
+
+int image_handler::begin_stream(void)
+{
+	if (!m_streaming)
+	{
+		cout << "Error: image_handler wasn't constructed for streaming" << endl;
+		return -1;
+	}
+#ifdef USING_OCV
+	cout << "Error: streaming is only supported for bitmaps" << endl;
+	return -1;
+#else
+	if (!fits_bmp(m_width, m_height))
+	{
+		cout << "Error: a " << m_width << " x " << m_height << " bitmap would be "
+			 << bmp_file_size(m_width, m_height) << " bytes, BMP stops at 4 GiB" << endl;
+		return -1;
+	}
+
+	m_stream.open(m_filename.c_str(), ios::binary | ios::out | ios::trunc);
+	if (!m_stream)
+	{
+		cout << "Error: could not open " << m_filename << " for writing" << endl;
+		return -1;
+	}
+	cout << "Streaming bitmap to: " << m_filename << endl;
+
+	//Same 24 bit layout as bitmap_image::save_image, rows padded to 4 bytes. fits_bmp
+	//has made sure all of these fit in 32 bits.
+	uint32_t row_size = (uint32_t)((3 * m_width + 3) & ~3);
+	uint32_t header_size = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE;
+	uint32_t image_size = (uint32_t)(bmp_file_size(m_width, m_height) - header_size);
+
+	//File header
+	write_le(m_stream, 19778, 2);	//"BM"
+	write_le(m_stream, header_size + image_size, 4);
+	write_le(m_stream, 0, 2);
+	write_le(m_stream, 0, 2);
+	write_le(m_stream, header_size, 4);
+
+	//Information header
+	write_le(m_stream, BMP_INFO_HEADER_SIZE, 4);
+	write_le(m_stream, (unsigned int)m_width, 4);
+	write_le(m_stream, (unsigned int)m_height, 4);
+	write_le(m_stream, 1, 2);	//Planes
+	write_le(m_stream, 24, 2);	//Bits per pixel
+	write_le(m_stream, 0, 4);	//No compression
+	write_le(m_stream, image_size, 4);
+	write_le(m_stream, 0, 4);
+	write_le(m_stream, 0, 4);
+	write_le(m_stream, 0, 4);
+	write_le(m_stream, 0, 4);
+
+	m_row_size = row_size;
+	return m_stream ? 0 : -1;
+#endif
+}
+
+template <typename CountT>
+int image_handler::write_band(int first_row, vector<CountT>& colours, const vector<float>* smooth)
+{
+	if (!m_stream.is_open() || 0 >= m_width)
+	{
+		cout << "Error: write_band called without begin_stream" << endl;
+		return -1;
+	}
+
+	int rows = (int)(colours.size() / m_width);
+	if (first_row < 0 || first_row + rows > m_height)
+	{
+		cout << "Error: band [" << first_row << ", " << first_row + rows << ") is outside the image" << endl;
+		return -1;
+	}
+	if (0 == rows)
+	{
+		return 0;
+	}
+
+	if (NULL != smooth)
+	{
+		build_smooth_palette();
+	}
+
+	//Bottom-up, so the band's last row comes first in the file and the rest follow on
+	//from it. The padding bytes at the end of each row stay zero.
+	m_band_buffer.assign((size_t)rows * m_row_size, 0);
+#pragma omp parallel for schedule(static)
+	for (int r = 0; r < rows; ++r)
+	{
+		size_t k = (size_t)(rows - 1 - r) * m_width;
+		colour_row(&colours[k], (NULL != smooth) ? &(*smooth)[k] : NULL, m_width, &m_band_buffer[(size_t)r * m_row_size]);
+	}
 
+	streamoff header_size = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE;
+	m_stream.seekp(header_size + (streamoff)(m_height - first_row - rows) * (streamoff)m_row_size);
+	m_stream.write((const char*)&m_band_buffer[0], (streamsize)m_band_buffer.size());
 
+	if (!m_stream)
+	{
+		cout << "Error: writing band at row " << first_row << " to " << m_filename << " failed" << endl;
+		return -1;
+	}
+	return 0;
+}
+
+int image_handler::end_stream(void)
+{
+	if (!m_stream.is_open())
+	{
+		return -1;
+	}
+	m_stream.close();
+	if (!m_stream)
+	{
+		cout << "Error: closing " << m_filename << " failed" << endl;
+		return -1;
+	}
+	cout << "Image wrote successfully" << endl;
+	return 0;
+}
 
+//The count buffers the plotter can render into
+template int image_handler::write_image<int>(window<int>&, vector<int>&, const vector<float>*, const antialias_samples*);
+template int image_handler::write_image<uint16_t>(window<int>&, vector<uint16_t>&, const vector<float>*, const antialias_samples*);
+template int image_handler::write_image<uint32_t>(window<int>&, vector<uint32_t>&, const vector<float>*, const antialias_samples*);
+template int image_handler::write_band<int>(int, vector<int>&, const vector<float>*);
+template int image_handler::write_band<uint16_t>(int, vector<uint16_t>&, const vector<float>*);
+template int image_handler::write_band<uint32_t>(int, vector<uint32_t>&, const vector<float>*);
+template void image_handler::colour_tile<int>(int, int, int, int, const int*, const float*);
+template void image_handler::colour_tile<uint16_t>(int, int, int, int, const uint16_t*, const float*);
+template void image_handler::colour_tile<uint32_t>(int, int, int, int, const uint32_t*, const float*);
@@ -5,9 +5,13 @@
 
 //#define USING_OCV
 
+#include <cstdint>
+#include <fstream>
 #include <string>
 #include <tuple>
 #include "window.hpp"
+#include "antialias.hpp"
+#include "mandel_simd.hpp"
 
 #ifdef USING_OCV
 #include <opencv2/core.hpp>
@@ -26,6 +30,22 @@ typedef tuple<uint8_t, uint8_t, uint8_t> RGB_T;
 
 					IMAGE_HANDLER
 
+	Either holds the whole image and writes it in one go with
+	write_image, or (when constructed for streaming) writes the
+	BMP a band of rows at a time. BMP rows are stored bottom-up,
+	so each band is written at its final position in the file and
+	only the current band's pixels are ever held here.
+
+	Colours come from palettes built once at construction, one
+	entry per iteration count and a finer one for smooth counts,
+	packed into 32 bits so eight can be gathered at once. Rows are
+	coloured in parallel straight into the bitmap's own rows.
+
+	BMP keeps the file and image sizes in 32 bit fields, so a
+	bitmap stops at 4 GiB (about 1.4 gigapixels). Anything bigger
+	is refused rather than written with sizes that have wrapped,
+	fits_bmp lets callers check before they render.
+
 ****************************************************************/
 
 class image_handler
@@ -39,20 +59,93 @@ private:
 	bitmap_image* m_img_bmp;
 #endif
 
+	//0x00RRGGBB for each count 0..m_max_iter
+	vector<uint32_t> m_palette;
+
+	//0x00RRGGBB every 1 / m_smooth_scale of an iteration, only built when smooth
+	//counts are first written
+	vector<uint32_t> m_smooth_palette;
+	double m_smooth_scale;
+
+	//Vector unit used for the palette lookups
+	simd_level m_simd_level;
+
+	//Streaming output, m_stream is only open between begin_stream & end_stream.
+	//Rows in the file are padded to m_row_size bytes.
+	bool m_streaming;
+	int m_width;
+	int m_height;
+	ofstream m_stream;
+	size_t m_row_size;
+	vector<unsigned char> m_band_buffer;
+
+	void build_palette(void);
+
+	void build_smooth_palette(void);
+
+	//Colours width pixels from counts, or from smooth if it isn't NULL, into bgr
+	template <typename CountT>
+	void colour_row(const CountT *counts, const float *smooth, int width, unsigned char *bgr);
+
+	//Recolours the supersampled pixels with the average colour of their samples
+	void apply_antialias(window<int>& screen, const antialias_samples& samples);
+
 public:
 
 	//Constructor & Destructor
 	image_handler(string filename, int max_iter, int dimension_x, int dimension_y); //Can extend this constructor to also take a bit-depth value later
 
+	//streaming = true doesn't allocate the image, use the *_stream functions instead of write_image
+	image_handler(string filename, int max_iter, int dimension_x, int dimension_y, bool streaming);
+
 	~image_handler();
 
 	//Utility funcs	
 	int set_filename(string filename);
 
-	RGB_T get_smooth_RGB_from_iter(int iterations);
+	//Points the handler at the next image of a batch. The bitmap is only reallocated
+	//when the size changes and the palette only rebuilt when max_iter does.
+	int reset(string filename, int max_iter, int dimension_x, int dimension_y);
+
+	//Defaults to the widest level the CPU supports, SIMD_SCALAR disables vectorisation
+	void set_simd_level(simd_level level);
+
+	//Takes fractional counts as well as whole ones
+	RGB_T get_smooth_RGB_from_iter(double iterations);
 
 	//Core handler work
-	int write_image(window<int>& screen, vector<int>& colours);
+
+	//CountT is whatever the plotter rendered into (int, uint16_t or uint32_t), if
+	//smooth isn't NULL the colours come from its fractional counts instead. The pixels
+	//in samples (from the plotter's antialias) get the average of their samples' colours.
+	template <typename CountT>
+	int write_image(window<int>& screen, vector<CountT>& colours, const vector<float>* smooth = NULL,
+					const antialias_samples* samples = NULL);
+
+	//Colours a width x height block at (x_begin, y_begin) into the image, counts & smooth
+	//are row-major and width wide. Blocks that don't overlap can be coloured from
+	//different threads at once. Nothing is written to disk until save_image.
+	template <typename CountT>
+	void colour_tile(int x_begin, int y_begin, int width, int height, const CountT *counts, const float *smooth = NULL);
+
+	int save_image(void);
+
+	//Bytes of a 24 bit BMP of that size, headers included
+	static uint64_t bmp_file_size(int dimension_x, int dimension_y);
+
+	//Whether a BMP of that size fits the format's 32 bit size fields
+	static bool fits_bmp(int dimension_x, int dimension_y);
+
+	//Streaming, opens the file and writes the headers for the full image. Fails
+	//without creating the file if the image is over the 4 GiB BMP limit.
+	int begin_stream(void);
+
+	//Colours the rows [first_row, first_row + colours.size() / width) and writes
+	//them to their place in the file, bands can arrive in any order
+	template <typename CountT>
+	int write_band(int first_row, vector<CountT>& colours, const vector<float>* smooth = NULL);
+
+	int end_stream(void);
 
 };
 
@@ -0,0 +1,170 @@
+/*
+	On-disk cache of rendered count buffers, so re-colouring a view skips the iteration.
+*/
+
+#include "iteration_cache.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__)
+#include <sys/stat.h>
+#elif defined(_WIN32) || defined(WIN32)
+#include <direct.h>
+#endif
+
+using namespace std;
+
+//"MITC" read as a native uint32, so a file from a host of the other byte order reads as a miss
+static const uint32_t cache_magic = 0x4354494D;
+
+//Bump whenever the layout changes or the kernels start giving different counts
+static const uint32_t cache_version = 1;
+
+//Fields in the order they are written, the key follows them
+struct cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count_bytes;
+	uint32_t has_smooth;
+	uint64_t num_pixels;
+	uint64_t key_length;
+};
+
+iteration_cache::iteration_cache(const string &directory)
+	: m_directory(directory)
+{
+	if (!m_directory.empty())
+	{
+		//Fails harmlessly if it's already there, a real problem shows up on the first store
+#if defined(__unix__)
+		mkdir(m_directory.c_str(), 0755);
+#elif defined(_WIN32) || defined(WIN32)
+		_mkdir(m_directory.c_str());
+#endif
+	}
+}
+
+string iteration_cache::path_for(const string &key) const
+{
+	//64 bit FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t c = 0; c < key.size(); c++)
+	{
+		hash ^= (unsigned char)key[c];
+		hash *= 1099511628211ULL;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "iter_%016llx.bin", (unsigned long long)hash);
+	return m_directory + name;
+}
+
+template <typename CountT>
+bool iteration_cache::load(const string &key, vector<CountT> &colours, vector<float> *smooth) const
+{
+	ifstream stream(path_for(key).c_str(), ios::binary | ios::in);
+	if (!stream)
+	{
+		return false;
+	}
+
+	cache_header header;
+	stream.read((char*)&header, sizeof(header));
+	if (!stream || cache_magic != header.magic || cache_version != header.version ||
+		sizeof(CountT) != header.count_bytes || (NULL != smooth && 0 == header.has_smooth) ||
+		0 == header.num_pixels || key.size() != header.key_length)
+	{
+		return false;
+	}
+
+	string stored_key(key.size(), '\0');
+	stream.read(&stored_key[0], key.size());
+	if (!stream || stored_key != key)
+	{
+		return false;
+	}
+
+	//Read into scratch buffers first so a truncated file leaves the caller's alone
+	vector<CountT> counts((size_t)header.num_pixels);
+	stream.read((char*)&counts[0], counts.size() * sizeof(CountT));
+	vector<float> fractions;
+	if (NULL != smooth)
+	{
+		fractions.resize((size_t)header.num_pixels);
+		stream.read((char*)&fractions[0], fractions.size() * sizeof(float));
+	}
+	if (!stream)
+	{
+		return false;
+	}
+
+	colours.swap(counts);
+	if (NULL != smooth)
+	{
+		smooth->swap(fractions);
+	}
+	return true;
+}
+
+template <typename CountT>
+bool iteration_cache::store(const string &key, const vector<CountT> &colours, const vector<float> *smooth) const
+{
+	if (colours.empty())
+	{
+		return false;
+	}
+	if (NULL != smooth && smooth->size() != colours.size())
+	{
+		cout << "Error: smooth counts don't match the iteration counts, not cached" << endl;
+		return false;
+	}
+
+	//Written next to the entry and renamed over it, so a reader never sees half a file
+	string path = path_for(key);
+	string temp_path = path + ".tmp";
+	{
+		ofstream stream(temp_path.c_str(), ios::binary | ios::out | ios::trunc);
+		if (!stream)
+		{
+			cout << "Error: could not open " << temp_path << " for writing" << endl;
+			return false;
+		}
+
+		cache_header header = { cache_magic, cache_version, (uint32_t)sizeof(CountT),
+								(NULL != smooth) ? 1u : 0u, (uint64_t)colours.size(), (uint64_t)key.size() };
+		stream.write((const char*)&header, sizeof(header));
+		stream.write(key.data(), key.size());
+		stream.write((const char*)&colours[0], colours.size() * sizeof(CountT));
+		if (NULL != smooth)
+		{
+			stream.write((const char*)&(*smooth)[0], smooth->size() * sizeof(float));
+		}
+		if (!stream)
+		{
+			cout << "Error: failed writing " << temp_path << endl;
+			stream.close();
+			remove(temp_path.c_str());
+			return false;
+		}
+	}
+
+	//rename won't replace an existing file on Windows
+	remove(path.c_str());
+	if (0 != rename(temp_path.c_str(), path.c_str()))
+	{
+		cout << "Error: could not move " << temp_path << " to " << path << endl;
+		remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+template bool iteration_cache::load<int>(const string&, vector<int>&, vector<float>*) const;
+template bool iteration_cache::load<uint16_t>(const string&, vector<uint16_t>&, vector<float>*) const;
+template bool iteration_cache::load<uint32_t>(const string&, vector<uint32_t>&, vector<float>*) const;
+template bool iteration_cache::store<int>(const string&, const vector<int>&, const vector<float>*) const;
+template bool iteration_cache::store<uint16_t>(const string&, const vector<uint16_t>&, const vector<float>*) const;
+template bool iteration_cache::store<uint32_t>(const string&, const vector<uint32_t>&, const vector<float>*) const;
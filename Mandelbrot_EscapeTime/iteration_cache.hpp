@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef _ITERATION_CACHE_HPP
+#define _ITERATION_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***************************************************************
+
+						ITERATION_CACHE
+
+	Keeps finished count buffers on disk so a view that has been
+	rendered before only needs colouring. Entries are keyed by a
+	string describing everything that decides the counts (window,
+	screen size, iteration cap, formula, see the plotter's
+	get_cache_key), and stored under a hash of it.
+
+	Each file is a small header followed by the raw counts in
+	the width they were rendered in and, if they were asked for,
+	the smooth counts. The full key is kept in the header, so a
+	hash collision or a file from an older format just reads as
+	a miss.
+
+****************************************************************/
+
+class iteration_cache
+{
+private:
+
+	std::string m_directory;
+
+	//Where the entry for key lives, a hash of it so any key makes a valid name
+	std::string path_for(const std::string &key) const;
+
+public:
+
+	//Entries are kept in directory (ending in a path separator), which is created if
+	//it doesn't exist yet
+	iteration_cache(const std::string &directory);
+
+	//Fills colours (and smooth if it isn't NULL) from the entry for key. False if
+	//there isn't one or it doesn't have what was asked for, colours is then untouched.
+	//CountT is int, uint16_t or uint32_t and has to be the type the entry was stored as.
+	template <typename CountT>
+	bool load(const std::string &key, std::vector<CountT> &colours, std::vector<float> *smooth = NULL) const;
+
+	//Writes colours (and smooth if it isn't NULL) as the entry for key, replacing any
+	//older one. Prints an error and returns false if the file can't be written.
+	template <typename CountT>
+	bool store(const std::string &key, const std::vector<CountT> &colours,
+			   const std::vector<float> *smooth = NULL) const;
+};
+
+#endif
@@ -1,6 +1,12 @@
 #include "image_handler.hpp"
+#include "iteration_cache.hpp"
 #include "mandel_plotter.hpp"
+#include "run_config.hpp"
+#include "view_batch.hpp"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
 
 #if defined (__unix__)
 #include <mpi.h>
@@ -13,148 +19,262 @@ using std::cout;
 //Filepath stuff
 #if defined(__unix__)
 const string default_image_filepath("../resources/mandelbrot/");
+const string default_cache_filepath("../resources/cache/");
 #elif defined(_WIN32) || defined(WIN32)
 const string default_image_filepath("..\\resources\\mandelbrot\\");
+const string default_cache_filepath("..\\resources\\cache\\");
 #endif
 const string default_image_filename("mandel.bmp");
 
 ///
-/// Get the params as master then broadcast to all MPI instances
+/// Ask for the params on the master, main broadcasts them with the rest of the run_config
 ///
 bool get_userdefined_params(int &testmode, int &width, int &height, int &max_iter, parallelisation_type &parallel_type)
 {
 	int para_type;
-	int p_rank;
-	int test_mode;
 
-#if defined(__unix__)
-	MPI_Comm_rank(MPI_COMM_WORLD, &p_rank);
-#endif
+	cout << "Use parallel test mode? 0 for no," <<
+		endl << "1 for 1k x 1k @ 500 iterations," << endl;
+	cout << "2 for 2k x 2k @ 600 iterations," <<
+		endl << "3 for 3k x 3k @ 700 iterations," << endl;
+	cout << "4 for 4k resolution image @ 800 iterations," <<
+		endl << "8 for 8k resolution image @ 800 iterations" << endl;
+	cin >> testmode;
 
-	if (0 == p_rank)
+	switch (testmode)
 	{
-		cout << "Use parallel test mode? 0 for no," <<
-			endl << "1 for 1k x 1k @ 500 iterations," << endl;
-		cout << "2 for 2k x 2k @ 600 iterations," <<
-			endl << "3 for 3k x 3k @ 700 iterations," << endl;
-		cout << "4 for 4k resolution image @ 800 iterations," <<
-			endl << "8 for 8k resolution image @ 800 iterations" << endl;
-		cin >> test_mode;
-
-		switch (testmode)
+	case 0:
+		cout << "Define image width (x): ";
+		cin >> width;
+		cout << endl << "Define image height(y): ";
+		cin >> height;
+		cout << endl << "Define the max number of iterations: ";
+		cin >> max_iter;
+		cout << endl << "Define parallelisation type: " << endl;
+		cout << "\t 0: no parallelisation\n" << \
+			"\t	1: OpenMP parallelisation\n" << \
+			"\t 2: MPI parallelisation\n" << \
+			"\t 3: OpenMP & MPI parallelisation\n" << \
+			"\t 4: Mariani-Silver subdivision (OpenMP tasks)" << endl;  \
+			cin >> para_type;
+		cout << endl;
+
+		if (0 == para_type)
 		{
-		case 0:
-			cout << "Define image width (x): ";
-			cin >> width;
-			cout << endl << "Define image height(y): ";
-			cin >> height;
-			cout << endl << "Define the max number of iterations: ";
-			cin >> max_iter;
-			cout << endl << "Define parallelisation type: " << endl;
-			cout << "\t 0: no parallelisation\n" << \
-				"\t	1: OpenMP parallelisation\n" << \
-				"\t 2: MPI parallelisation\n" << \
-				"\t 3: OpenMP & MPI parallelisation" << endl;  \
-				cin >> para_type;
-			cout << endl;
-
-			if (0 == para_type)
-			{
-				parallel_type = NO_PARALLEL;
-			}
-			else if (1 == para_type)
-			{
-				parallel_type = OMP_PARALLEL;
-			}
-			else if (2 == para_type)
-			{
-				parallel_type = MPI_PARALLEL;
-			}
-			else if (3 == para_type)
+			parallel_type = NO_PARALLEL;
+		}
+		else if (1 == para_type)
+		{
+			parallel_type = OMP_PARALLEL;
+		}
+		else if (2 == para_type)
+		{
+			parallel_type = MPI_PARALLEL;
+		}
+		else if (3 == para_type)
+		{
+			parallel_type = BOTH_PARALLEL;
+		}
+		else if (4 == para_type)
+		{
+			parallel_type = SUBDIVIDE_PARALLEL;
+		}
+		else
+		{
+			cout << "Error: Invalid parallelisation type" << endl;
+		}
+		break;
+
+	case 1:
+		width = 1000;
+		height = 1000;
+		max_iter = 500;
+		parallel_type = MPI_PARALLEL;
+		break;
+
+	case 2:
+		width = 2000;
+		height = 2000;
+		max_iter = 600;
+		parallel_type = MPI_PARALLEL;
+		break;
+
+	case 3:
+		width = 3000;
+		height = 3000;
+		max_iter = 700;
+		parallel_type = MPI_PARALLEL;
+		break;
+
+	case 4:
+		width = 3840;
+		height = 2160;
+		max_iter = 800;
+		parallel_type = MPI_PARALLEL;
+		break;
+
+	case 8:
+		width = 7680;
+		height = 4320;
+		max_iter = 800;
+		parallel_type = MPI_PARALLEL;
+		break;
+
+	default:
+		cout << "invalid test mode provided, reverting to case 1" << endl;
+		width = 1000;
+		height = 1000;
+		max_iter = 500;
+		parallel_type = MPI_PARALLEL;
+		break;
+	}
+
+	if ((width > 0) && (height > 0) && (max_iter > 0))
+		return true;
+	else
+		return false;
+}
+
+///
+/// Ask for (or default) the path the image is written to, only called on the master.
+/// A path given in the run_config is used as it is.
+///
+string get_image_filepath(int testmode, const string &output)
+{
+	string new_image_filepath, new_image_filename;
+	if (!output.empty())
+	{
+		return output;
+	}
+	if (0 == testmode)
+	{
+		cout << "Fractal computation complete, please enter absolute path of image including name or enter 'default' to use the default values: ";
+		cin >> new_image_filepath;
+		if ("default" == new_image_filepath)
+		{
+			cout << "Using default path" << endl;
+			new_image_filename = default_image_filename;
+			new_image_filepath = default_image_filepath;
+		}
+		else
+		{
+			//Get the filename out of the path
+			size_t found;
+#if defined(__unix__)
+			found = new_image_filepath.find_last_of("/");
+#elif defined(_WIN32) || defined(WIN32)
+			found = new_image_filepath.find_last_of("\\");
+#endif
+			//The directory keeps its separator, as the default one does
+			if (string::npos != found)
 			{
-				parallel_type = BOTH_PARALLEL;
+				new_image_filename = new_image_filepath.substr(found + 1);
+				new_image_filepath = new_image_filepath.substr(0, found + 1);
 			}
 			else
 			{
-				cout << "Error: Invalid parallelisation type" << endl;
+				new_image_filename = new_image_filepath;
+				new_image_filepath = "";
 			}
-			break;
+			cout << "Writing image to: " << new_image_filepath << endl;
+		}
+	}
+	else
+	{
+		cout << "Writing to default path" << endl;
+		new_image_filename = default_image_filename;
+		new_image_filepath = default_image_filepath;
+	}
+	return new_image_filepath + new_image_filename;
+}
 
-		case 1:
-			width = 1000;
-			height = 1000;
-			max_iter = 500;
-			parallel_type = MPI_PARALLEL;
-			break;
+///
+/// Render every view in the batch file with one plotter, image and count buffer, so only
+/// the first view pays for setting them up. Collective, returns 0 if anything was rendered.
+///
+int render_batch(const string &batch_filepath, const run_config &config, mandel_logger *logger)
+{
+	parallelisation_type parallel_type = config.parallel_type;
+	bool smooth_colouring = (0 != config.smooth);
 
-		case 2:
-			width = 2000;
-			height = 2000;
-			max_iter = 600;
-			parallel_type = MPI_PARALLEL;
-			break;
+	int p_rank = 0;
+#if defined (__unix__)
+	MPI_Comm_rank(MPI_COMM_WORLD, &p_rank);
+#endif
 
-		case 3:
-			width = 3000;
-			height = 3000;
-			max_iter = 700;
-			parallel_type = MPI_PARALLEL;
-			break;
+	vector<view_spec> views;
+	if (0 == p_rank)
+	{
+		read_view_batch(batch_filepath, views);
+	}
+	broadcast_view_batch(views);
+	if (views.empty())
+	{
+		if (0 == p_rank)
+		{
+			cout << "Error: no views to render in " << batch_filepath << endl;
+		}
+		return -1;
+	}
 
-		case 4:
-			width = 3840;
-			height = 2160;
-			max_iter = 800;
-			parallel_type = MPI_PARALLEL;
-			break;
+	auto batch_start = chrono::steady_clock::now();
 
-		default:
-			cout << "invalid test mode provided, reverting to case 1" << endl;
-			width = 1000;
-			height = 1000;
-			max_iter = 500;
-			parallel_type = MPI_PARALLEL;
-			break;
+	const view_spec &first = views[0];
+	window<int> screen(0, first.width, 0, first.height);
+	mandel_plotter plotter(screen, window<double>(first.min_real, first.max_real, first.min_imaginary, 0),
+						   first.max_iter, first.formula, logger, first.order);
+	plotter.set_num_threads(config.num_threads);
+	plotter.set_tile_size(config.tile_size);
+	plotter.set_interior_checks(INTERIOR_CARDIOID | INTERIOR_PERIODICITY);
+
+	//Only rank 0 writes images
+	image_handler img_hand("", first.max_iter, (0 == p_rank) ? first.width : 0, (0 == p_rank) ? first.height : 0);
+
+	//Resized for each view, they only reallocate when a view is bigger than any before it
+	vector<uint16_t> colours_16;
+	vector<uint32_t> colours_32;
+	vector<float> smooth;
+	vector<float> *smooth_out = smooth_colouring ? &smooth : NULL;
+
+	for (size_t v = 0; v < views.size(); v++)
+	{
+		const view_spec &view = views[v];
+		screen.define_window(0, view.width, 0, view.height);
+		plotter.set_view(screen, window<double>(view.min_real, view.max_real, view.min_imaginary, 0),
+						 view.max_iter, view.formula, view.order);
+
+		bool compact_counts = (view.max_iter <= numeric_limits<uint16_t>::max());
+		if (compact_counts)
+		{
+			colours_16.resize(screen.size());
+			plotter.fractal(colours_16, parallel_type, smooth_out);
+		}
+		else
+		{
+			colours_32.resize(screen.size());
+			plotter.fractal(colours_32, parallel_type, smooth_out);
 		}
-#if defined(__unix__)
-		MPI_Bcast(&testmode,	//Buffer 
-			1,				//Amount of data to send
-			MPI_INT,					//data type
-			0,
-			MPI_COMM_WORLD);
-
-		MPI_Bcast(&width,	//Buffer 
-			1,				//Amount of data to send
-			MPI_INT,					//data type
-			0,
-			MPI_COMM_WORLD);
-
-		MPI_Bcast(&height,	//Buffer 
-			1,				//Amount of data to send
-			MPI_INT,					//data type
-			0,
-			MPI_COMM_WORLD);
-
-		MPI_Bcast(&max_iter,	//Buffer 
-			1,				//Amount of data to send
-			MPI_INT,					//data type
-			0,
-			MPI_COMM_WORLD);
-
-		MPI_Bcast(&parallel_type,	//Buffer 
-			1,				//Amount of data to send
-			MPI_INT,					//data type
-			0,
-			MPI_COMM_WORLD);
-#endif
-	} // END IF RANK = 0
 
-	cout << p_rank << ": leaving get_params()" << endl;
+		if (0 == p_rank)
+		{
+			img_hand.reset(view.output, view.max_iter, view.width, view.height);
+			if (compact_counts)
+			{
+				img_hand.write_image(screen, colours_16, smooth_out);
+			}
+			else
+			{
+				img_hand.write_image(screen, colours_32, smooth_out);
+			}
+		}
+	}
 
-	if ((width > 0) && (height > 0) && (max_iter > 0))
-		return true;
-	else
-		return false;
+	if (0 == p_rank)
+	{
+		cout << "Batch of " << views.size() << " views rendered in "
+			 << chrono::duration<double>(chrono::steady_clock::now() - batch_start).count() << " [s]" << endl;
+	}
+	return 0;
 }
 
 int main(int argc, char **argv)
@@ -169,28 +289,80 @@ int main(int argc, char **argv)
 		Initial Parameter declaration
 	***************************************/
 
-	/*
-	Store our first and third order mandelbrot lamba's inside a std::function for readability
-	*/
-	using Complex = std::complex<double>;
-	std::function<Complex(Complex, Complex)> first_order_mandel = [](Complex z, Complex c) -> Complex {return z * z + c; };
-	std::function<Complex(Complex, Complex)> third_order_mandel = [](Complex z, Complex c) -> Complex {return z * z * z + c; };
+	//Rank 0 works out the whole config (defaults, then --config, then the rest of the
+	//command line, or the questions of --interactive) and shares it in one broadcast
+	run_config config;
+	default_run_config(config);
+	if (0 == p_rank)
+	{
+		parse_run_config(argc, argv, config);
+		if (RUN_CONFIG_RENDER == config.status && config.interactive &&
+			!get_userdefined_params(config.test_mode, config.width, config.height, config.max_iter, config.parallel_type))
+		{
+			config.status = RUN_CONFIG_ERROR;
+		}
+		//The answers skip parse_run_config's checks, the one that matters for the writer is
+		//the BMP size limit, found out now rather than after the render
+		if (RUN_CONFIG_RENDER == config.status && config.interactive && !image_handler::fits_bmp(config.width, config.height))
+		{
+			cout << "Error: a " << config.width << " x " << config.height << " bitmap would be "
+				 << image_handler::bmp_file_size(config.width, config.height) << " bytes, BMP stops at 4 GiB" << endl;
+			config.status = RUN_CONFIG_ERROR;
+		}
+		if (RUN_CONFIG_ERROR == config.status)
+		{
+			cout << "Run with --help for the options" << endl;
+		}
+	}
+	broadcast_run_config(config);
+	if (RUN_CONFIG_RENDER != config.status)
+	{
+#if defined (__unix__)
+		MPI_Finalize();
+#endif
+		return (RUN_CONFIG_ERROR == config.status) ? 1 : 0;
+	}
 
-	int testmode, width, height, max_iter;
-	parallelisation_type parallel_type = NO_PARALLEL;
+	int testmode = config.test_mode;
+	int width = config.width;
+	int height = config.height;
+	int max_iter = config.max_iter;
+	parallelisation_type parallel_type = config.parallel_type;
 
-	/**************************************
-				Test Mode Config
-	***************************************/
+	//Rows per band when streaming the image straight to disk, 0 renders the whole
+	//image in memory first. Streaming keeps memory proportional to the band height.
+	int stream_band_rows = (OUTPUT_BMP_BANDS == config.format) ? config.band_rows : 0;
+
+	//Colour each tile as soon as it's computed instead of filling a count buffer first,
+	//for bulk renders where only the image is wanted
+	bool fused_colouring = (OUTPUT_BMP_TILES == config.format);
+
+	//Colour from the fractional escape counts rather than the integer ones, which
+	//gets rid of the banding without having to raise max_iter
+	bool smooth_colouring = (0 != config.smooth);
+
+	//Keep the counts of each in-memory render on disk and reuse them when the same view
+	//comes up again, so changing the palette only costs the colouring
+	bool use_iteration_cache = (0 != config.iteration_cache);
+
+	//Raise the cap to this after the first render, only the pixels that were still
+	//at max_iter are carried on from where they stopped. 0 to render once.
+	int extended_max_iter = config.extended_max_iter;
 
-	//This retrieves the parameters for the test & shares between all processes
+	//Replace max_iter with an estimate from a sparse sample of the view, the smallest
+	//cap that 99.5% of the sampled pixels that escape get out under
+	bool auto_max_iter = (0 != config.auto_max_iter);
 
-		//get_userdefined_params(testmode, width, height, max_iter, parallel_type);
-	testmode = 1;
-	width = 1920;
-	height = 1080;
-	max_iter = 500;
-	parallel_type = OMP_PARALLEL;
+	//Supersample the pixels on an edge on a grid x grid jittered pattern before the image
+	//is written, the rest keep their single sample. 0 for no antialiasing.
+	int antialias_grid = config.antialias_grid;
+
+	//Render the views listed in this file (see view_batch.hpp) in one run instead of the
+	//single view below. Uses the parallelisation, thread, tile and smooth options only.
+	string batch_filepath = config.batch;
+
+	//Written on rank 0, empty for the default path (or to ask for one in test mode 0)
+	string output_filepath = config.output;
 
 	/**************************************
 					Core
@@ -200,70 +372,221 @@ int main(int argc, char **argv)
 	window<int> screen(0, width, 0, height);
 
 	//Fourth value doesn't matter for fractal as it is calculated based on other values
-	//window<double> fractal(-2.2, 1.2, -1.7, 1.7); //Zoomed out preset
-	//double max_imag = 0.1 + (0.385-0.375) * height / width;
-	window<double> fractal(0.3575, 0.3585, 0.11, 0); //Zoomed in preset
+	window<double> fractal(config.min_real, config.max_real, config.min_imaginary, 0);
 
 	//Create the mandel_logger - Don't care about alternate logfile for now
 	mandel_logger logger(Log_level::DEFAULT);
 
+	if (!batch_filepath.empty())
+	{
+		int result = render_batch(batch_filepath, config, &logger);
+#if defined (__unix__)
+		MPI_Finalize();
+#endif
+		return result;
+	}
+
 	//Now create the plotter using the parameters specified above
-	mandel_plotter plotter(screen, fractal, max_iter, first_order_mandel, &logger);
+	mandel_plotter plotter(screen, fractal, max_iter, config.formula, &logger, config.order);
+	plotter.set_num_threads(config.num_threads);
+	plotter.set_tile_size(config.tile_size);
+
+	//Skip interior points where we can, doesn't change the iteration counts
+	plotter.set_interior_checks(INTERIOR_CARDIOID | INTERIOR_PERIODICITY);
+
+	if (extended_max_iter > max_iter)
+	{
+		plotter.set_orbit_saving(true);
+	}
+
+	//Deep zoom, centred on a point given as decimal strings so it can carry more digits
+	//than a double, and width is the real extent of the image. The pixels are then
+	//iterated against a high precision reference orbit, empty keeps the window above.
+	//e.g. "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 1e-25
+	string deep_zoom_real = config.centre_real;
+	string deep_zoom_imaginary = config.centre_imaginary;
+	double deep_zoom_width = config.zoom_width;
+	if (!deep_zoom_real.empty())
+	{
+		plotter.set_perturbation(true);
+		plotter.set_series_approximation(true);
+		plotter.set_centre(deep_zoom_real, deep_zoom_imaginary, deep_zoom_width);
+	}
+
+	if (auto_max_iter)
+	{
+		max_iter = plotter.estimate_iter_max();
+		plotter.set_iter_max(max_iter);
+	}
 
 	//This will be the vector that will contain the iterations for each pixel point.
 	//Doing it in this way means we can very easily add other polynomials to see how
-	//the colours change.
-	vector<int> colours(screen.size());
+	//the colours change. 16 bit counts halve the memory and MPI traffic, so they are
+	//used whenever max_iter fits, only one of the two is ever filled.
+	bool compact_counts = (max(max_iter, extended_max_iter) <= numeric_limits<uint16_t>::max());
+	bool streaming = (0 < stream_band_rows);
+	bool count_buffer = !streaming && !fused_colouring;
+	vector<uint16_t> colours_16((compact_counts && count_buffer) ? screen.size() : 0);
+	vector<uint32_t> colours_32((!compact_counts && count_buffer) ? screen.size() : 0);
+	vector<float> smooth;
+	vector<float> *smooth_out = smooth_colouring ? &smooth : NULL;
+
+	if (streaming)
+	{
+		//Each band is coloured and written out as soon as rank 0 has it
+		string image_filepath = (0 == p_rank) ? get_image_filepath(testmode, output_filepath) : "";
+		image_handler img_hand(image_filepath, max_iter, screen.width(), screen.height(), true);
+		if (0 == p_rank)
+		{
+			img_hand.begin_stream();
+		}
+
+		if (compact_counts)
+		{
+			plotter.fractal_streamed<uint16_t>(parallel_type, stream_band_rows,
+				[&](int first_row, vector<uint16_t> &band, vector<float> *smooth) { img_hand.write_band(first_row, band, smooth); },
+				smooth_colouring);
+		}
+		else
+		{
+			plotter.fractal_streamed<uint32_t>(parallel_type, stream_band_rows,
+				[&](int first_row, vector<uint32_t> &band, vector<float> *smooth) { img_hand.write_band(first_row, band, smooth); },
+				smooth_colouring);
+		}
+
+		if (0 == p_rank)
+		{
+			img_hand.end_stream();
+		}
+#if defined (__unix__)
+		MPI_Finalize();
+#endif
+		return 0;
+	}
+
+	if (fused_colouring)
+	{
+		//Tiles are only ever handed to rank 0, so that's the only one that needs an image
+		string image_filepath = (0 == p_rank) ? get_image_filepath(testmode, output_filepath) : "";
+		image_handler img_hand(image_filepath, max_iter, (0 == p_rank) ? screen.width() : 0,
+							   (0 == p_rank) ? screen.height() : 0);
+
+		if (compact_counts)
+		{
+			plotter.fractal_fused<uint16_t>(parallel_type, [&](const tile &t, const uint16_t *counts, const float *smooth)
+			{
+				img_hand.colour_tile(t.x_begin, t.y_begin, t.x_end - t.x_begin, t.y_end - t.y_begin, counts, smooth);
+			}, NULL, smooth_out);
+		}
+		else
+		{
+			plotter.fractal_fused<uint32_t>(parallel_type, [&](const tile &t, const uint32_t *counts, const float *smooth)
+			{
+				img_hand.colour_tile(t.x_begin, t.y_begin, t.x_end - t.x_begin, t.y_end - t.y_begin, counts, smooth);
+			}, NULL, smooth_out);
+		}
+
+		if (0 == p_rank)
+		{
+			img_hand.save_image();
+		}
+#if defined (__unix__)
+		MPI_Finalize();
+#endif
+		return 0;
+	}
+
+	//Rank 0 looks the view up in the cache, every rank has to agree on skipping fractal
+	//as it is collective. A custom formula has no key and is always rendered.
+	string cache_key = (use_iteration_cache && 0 == extended_max_iter) ? plotter.get_cache_key(parallel_type) : "";
+	iteration_cache cache(cache_key.empty() ? "" : default_cache_filepath);
+	int cache_hit = 0;
+	if (!cache_key.empty())
+	{
+		if (0 == p_rank)
+		{
+			auto load_start = chrono::steady_clock::now();
+			cache_hit = compact_counts ? cache.load(cache_key, colours_16, smooth_out) :
+										 cache.load(cache_key, colours_32, smooth_out);
+			if (cache_hit)
+			{
+				cout << "Iterations loaded from cache in "
+					 << chrono::duration<double>(chrono::steady_clock::now() - load_start).count() << " [s]" << endl;
+			}
+		}
+#if defined (__unix__)
+		MPI_Bcast(&cache_hit, 1, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
+	}
 
 	//Now plot the fractal, for convenience sake this is fairly well wrapped up, however
 	//when it comes to performance testing and parallelization there will likely be changes
 	//to the underlying way in which it computes these fractals.
-	plotter.fractal(colours, parallel_type);
-
-	if (0 == p_rank)
+	if (!cache_hit)
 	{
-		string new_image_filepath, new_image_filename;
-		if (0 == testmode)
+		if (compact_counts)
+		{
+			plotter.fractal(colours_16, parallel_type, smooth_out);
+		}
+		else
+		{
+			plotter.fractal(colours_32, parallel_type, smooth_out);
+		}
+
+		if (extended_max_iter > max_iter)
 		{
-			cout << "Fractal computation complete, please enter absolute path of image including name or enter 'default' to use the default values: ";
-			cin >> new_image_filepath;
-			if ("default" == new_image_filepath)
+			if (compact_counts)
 			{
-				cout << "Using default path" << endl;
-				new_image_filename = default_image_filename;
-				new_image_filepath = default_image_filepath;
+				plotter.extend_iterations(colours_16, parallel_type, extended_max_iter, smooth_out);
 			}
 			else
 			{
-				//Get the filename out of the path
-				size_t found;
-#if defined(__unix__)
-				found = new_image_filepath.find_last_of("/");
-#elif defined(_WIN32) || defined(WIN32)
-				found = new_image_filepath.find_last_of("\\");
-#endif
-				if (0 < found)
-				{
-					new_image_filename = new_image_filepath.substr(found + 1);
-					new_image_filepath = new_image_filepath.substr(0, found);
-				}
-				cout << "Writing image to: " << new_image_filepath << endl;
+				plotter.extend_iterations(colours_32, parallel_type, extended_max_iter, smooth_out);
 			}
+			max_iter = extended_max_iter;
 		}
-		else
+
+		if (!cache_key.empty() && 0 == p_rank)
 		{
-			cout << "Writing to default path" << endl;
-			new_image_filename = default_image_filename;
-			new_image_filepath = default_image_filepath;
+			if (compact_counts)
+			{
+				cache.store(cache_key, colours_16, smooth_out);
+			}
+			else
+			{
+				cache.store(cache_key, colours_32, smooth_out);
+			}
 		}
+	}
+
+	if (0 == p_rank)
+	{
 		//Finally create the image handler which will convert the iterations in the Colours
 		//Vector to RGB and write the image to the filepath provided.
-		image_handler img_hand((new_image_filepath + new_image_filename),
+		image_handler img_hand(get_image_filepath(testmode, output_filepath),
 			max_iter,
 			screen.width(),
 			screen.height());
 
-		img_hand.write_image(screen, colours);
+		//Only rank 0 has the whole buffer, so the extra samples are all taken here
+		antialias_samples samples;
+		const antialias_samples *samples_out = (antialias_grid > 0) ? &samples : NULL;
+		if (compact_counts)
+		{
+			if (NULL != samples_out)
+			{
+				plotter.antialias(colours_16, parallel_type, samples, smooth_out, antialias_grid);
+			}
+			img_hand.write_image(screen, colours_16, smooth_out, samples_out);
+		}
+		else
+		{
+			if (NULL != samples_out)
+			{
+				plotter.antialias(colours_32, parallel_type, samples, smooth_out, antialias_grid);
+			}
+			img_hand.write_image(screen, colours_32, smooth_out, samples_out);
+		}
 	}
 #if defined (__unix__)
 	MPI_Finalize();
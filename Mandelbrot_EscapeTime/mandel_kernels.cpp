@@ -0,0 +1,87 @@
+/*
+	Kernel selection for the mandel_plotter, maps user supplied std::functions
+	onto the specialised kernels where possible.
+*/
+
+#include "mandel_kernels.hpp"
+
+#include <cstdlib>
+
+//Highest multibrot order a name can ask for
+#define MAX_FORMULA_ORDER 64
+
+//Points away from the axes so that z^2 + c and z^3 + c can't coincide by accident
+static const Complex formula_sample_points[] =
+{
+	Complex(0.3575, 0.1105),
+	Complex(-0.75, 0.1),
+	Complex(-1.2345, -0.6789),
+	Complex(0.25, 0.5)
+};
+
+template <typename Kernel>
+static bool matches_kernel(const std::function<Complex(Complex, Complex)> &mandel_func, const Kernel &kernel)
+{
+	for (const Complex &c : formula_sample_points)
+	{
+		//Check a couple of steps of the orbit rather than a single application
+		double zr = c.real();
+		double zi = c.imag();
+		Complex z(c);
+		for (int step = 0; step < 3; ++step)
+		{
+			kernel(zr, zi, c.real(), c.imag());
+			z = mandel_func(z, c);
+			if (z.real() != zr || z.imag() != zi)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+mandel_formula identify_formula(const std::function<Complex(Complex, Complex)> &mandel_func)
+{
+	if (!mandel_func)
+	{
+		return CUSTOM_FORMULA;
+	}
+
+	if (matches_kernel(mandel_func, first_order_kernel()))
+	{
+		return FIRST_ORDER;
+	}
+	else if (matches_kernel(mandel_func, third_order_kernel()))
+	{
+		return THIRD_ORDER;
+	}
+
+	return CUSTOM_FORMULA;
+}
+
+bool parse_formula(const std::string &name, mandel_formula &formula, int &order)
+{
+	if ("first" == name)
+	{
+		formula = FIRST_ORDER;
+		order = 2;
+		return true;
+	}
+	if ("third" == name)
+	{
+		formula = THIRD_ORDER;
+		order = 3;
+		return true;
+	}
+
+	char *end = NULL;
+	long value = strtol(name.c_str(), &end, 10);
+	if (name.empty() || '\0' != *end || value < 2 || value > MAX_FORMULA_ORDER)
+	{
+		return false;
+	}
+	formula = MULTIBROT;
+	order = (int)value;
+	return true;
+}
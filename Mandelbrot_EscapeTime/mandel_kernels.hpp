@@ -0,0 +1,352 @@
+#pragma once
+
+#ifndef _MANDEL_KERNELS_HPP
+#define _MANDEL_KERNELS_HPP
+
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <string>
+
+// Use an alias to simplify the use of complex type
+using Complex = std::complex<double>;
+
+/***************************************************************
+
+					ITERATION KERNELS
+
+	Each kernel applies a single iteration of z -> f(z, c) to the
+	split real/imaginary parts of z. Keeping them as small functors
+	(rather than a std::function) means the escape loop below is
+	instantiated once per kernel and the call is fully inlined.
+
+	simd_order tells the plotter which vectorised loop in
+	mandel_simd.hpp matches the kernel, 0 if there isn't one.
+	known_interior is an analytic test for points that are in the
+	set, only the standard z^2 + c set has one.
+
+****************************************************************/
+
+//Shortcuts that can be enabled per render to avoid running interior points
+//all the way to iter_max, combine with |
+enum interior_check
+{
+	INTERIOR_NONE = 0,
+	INTERIOR_CARDIOID = 1,		//Main cardioid & period-2 bulb membership test
+	INTERIOR_PERIODICITY = 2	//Brent style cycle detection on the orbit
+};
+
+//Number of pixels each shortcut resolved during a render
+struct interior_stats
+{
+	long long cardioid;
+	long long periodic;
+};
+
+// Main cardioid: q(q + (x - 1/4)) <= y^2 / 4 where q = (x - 1/4)^2 + y^2
+// Period-2 bulb: (x + 1)^2 + y^2 <= 1/16
+inline bool in_cardioid_or_bulb(double cr, double ci)
+{
+	double xq = cr - 0.25;
+	double ci2 = ci * ci;
+	double q = xq * xq + ci2;
+	if (q * (q + xq) <= 0.25 * ci2)
+	{
+		return true;
+	}
+	double xb = cr + 1.0;
+	return (xb * xb + ci2 <= 0.0625);
+}
+
+//Identifies which kernel the plotter will instantiate for the render
+enum mandel_formula
+{
+	FIRST_ORDER,		//z^2 + c
+	THIRD_ORDER,		//z^3 + c
+	MULTIBROT,			//z^N + c for any integer N >= 2
+	CUSTOM_FORMULA		//User supplied function, no specialisation possible
+};
+
+//z^2 + c
+//Written out by hand, but in the same operation order as std::complex so
+//the results are identical to the lambda version in main.cpp
+struct first_order_kernel
+{
+	static const int simd_order = 2;
+
+	static inline bool known_interior(double cr, double ci)
+	{
+		return in_cardioid_or_bulb(cr, ci);
+	}
+
+	inline void operator()(double &zr, double &zi, double cr, double ci) const
+	{
+		double zr2 = zr * zr;
+		double zi2 = zi * zi;
+		zi = 2.0 * zr * zi + ci;
+		zr = zr2 - zi2 + cr;
+	}
+};
+
+//z^3 + c, computed as (z * z) * z
+struct third_order_kernel
+{
+	static const int simd_order = 3;
+
+	static inline bool known_interior(double, double)
+	{
+		return false;
+	}
+
+	inline void operator()(double &zr, double &zi, double cr, double ci) const
+	{
+		double wr = zr * zr - zi * zi;
+		double wi = zr * zi + zi * zr;
+		double tr = wr * zr - wi * zi;
+		double ti = wr * zi + wi * zr;
+		zr = tr + cr;
+		zi = ti + ci;
+	}
+};
+
+//z^N + c by repeated multiplication, N is fixed for the whole render
+struct multibrot_kernel
+{
+	static const int simd_order = 0;
+
+	static inline bool known_interior(double, double)
+	{
+		return false;
+	}
+
+	int m_order;
+
+	explicit multibrot_kernel(int order) : m_order(order) {}
+
+	inline void operator()(double &zr, double &zi, double cr, double ci) const
+	{
+		double pr = zr;
+		double pi = zi;
+		for (int n = 1; n < m_order; ++n)
+		{
+			double tr = pr * zr - pi * zi;
+			double ti = pr * zi + pi * zr;
+			pr = tr;
+			pi = ti;
+		}
+		zr = pr + cr;
+		zi = pi + ci;
+	}
+};
+
+//Fallback for arbitrary user lambdas, still goes through the std::function
+struct custom_kernel
+{
+	static const int simd_order = 0;
+
+	static inline bool known_interior(double, double)
+	{
+		return false;
+	}
+
+	const std::function<Complex(Complex, Complex)> &m_func;
+
+	explicit custom_kernel(const std::function<Complex(Complex, Complex)> &func) : m_func(func) {}
+
+	inline void operator()(double &zr, double &zi, double cr, double ci) const
+	{
+		Complex z = m_func(Complex(zr, zi), Complex(cr, ci));
+		zr = z.real();
+		zi = z.imag();
+	}
+};
+
+// Iterate c under the given kernel until it escapes or iter_max is reached
+// |z| < 2 is tested as |z|^2 < 4 to avoid the square root on every iteration
+template <typename Kernel>
+inline int escape_time(const Kernel &kernel, double cr, double ci, int iter_max)
+{
+	double zr = cr;
+	double zi = ci;
+	int iter = 0;
+
+	while (zr * zr + zi * zi < 4.0 && iter < iter_max)
+	{
+		kernel(zr, zi, cr, ci);
+		iter++;
+	}
+
+	return iter;
+}
+
+// Same as escape_time, but checks the orbit for an exact cycle using Brent's
+// method (compare against a saved z, re-saved at every power of two). Once z
+// repeats exactly the orbit can never escape, so returning iter_max gives the
+// same count as running it out.
+template <typename Kernel>
+inline int escape_time_periodic(const Kernel &kernel, double cr, double ci, int iter_max, bool &cycle_found)
+{
+	double zr = cr;
+	double zi = ci;
+	double saved_r = zr;
+	double saved_i = zi;
+	int save_at = 1;
+	int iter = 0;
+
+	while (zr * zr + zi * zi < 4.0 && iter < iter_max)
+	{
+		kernel(zr, zi, cr, ci);
+		iter++;
+
+		if (zr == saved_r && zi == saved_i)
+		{
+			cycle_found = true;
+			return iter_max;
+		}
+		if (iter == save_at)
+		{
+			saved_r = zr;
+			saved_i = zi;
+			save_at <<= 1;
+		}
+	}
+
+	return iter;
+}
+
+// escape_time carried on from z at iteration iter, for raising the cap on a point
+// that an earlier call stopped at (z_0 = c, iter = 0 starts from scratch). z is
+// left where it stopped, so the count comes out the same as a single call with the
+// higher cap. Periodic checks for a cycle from here on like escape_time_periodic,
+// z is meaningless once one is found.
+template <bool Periodic, typename Kernel>
+inline int escape_time_from(const Kernel &kernel, double cr, double ci, int iter, int iter_max,
+							double &zr, double &zi, bool &cycle_found)
+{
+	double saved_r = zr;
+	double saved_i = zi;
+	int save_at = 1;
+	int steps = 0;
+
+	while (zr * zr + zi * zi < 4.0 && iter < iter_max)
+	{
+		kernel(zr, zi, cr, ci);
+		iter++;
+
+		if (Periodic)
+		{
+			steps++;
+			if (zr == saved_r && zi == saved_i)
+			{
+				cycle_found = true;
+				return iter_max;
+			}
+			if (steps == save_at)
+			{
+				saved_r = zr;
+				saved_i = zi;
+				save_at <<= 1;
+			}
+		}
+	}
+
+	return iter;
+}
+
+//Escaped points are iterated on until |z| reaches this before their fractional count
+//is taken. mu is only exactly continuous in the limit of a large bailout, with 2 the
+//error is still big enough to leave faint steps where the bands meet.
+#define SMOOTH_BAILOUT 256.0
+
+//Cap on those extra iterations, a custom formula needn't grow like z^2 does
+#define SMOOTH_MAX_EXTRA 16
+
+// Fractional (normalised) escape count mu = n + 1 - log(log2|z_n|) / log(order),
+// from the first z outside the bailout and its count. z is carried on to
+// SMOOTH_BAILOUT first, each iteration adds one to n and about one to the log
+// term, so mu keeps to the scale of the integer count (a few above it where c
+// itself is large) but no longer jumps at the band edges. Points that never
+// escape get iter_max. The extra iterations
+// are always done in double, past the bailout the precision of c doesn't matter.
+template <typename Kernel>
+inline float smooth_iteration_count(const Kernel &kernel, int iter, double zr, double zi, double cr, double ci,
+									int iter_max, double log_order)
+{
+	if (iter >= iter_max)
+	{
+		return (float)iter_max;
+	}
+
+	double modulus = zr * zr + zi * zi;
+	for (int extra = 0; extra < SMOOTH_MAX_EXTRA && modulus < SMOOTH_BAILOUT * SMOOTH_BAILOUT; ++extra)
+	{
+		kernel(zr, zi, cr, ci);
+		modulus = zr * zr + zi * zi;
+		iter++;
+	}
+
+	double log2_modulus = 0.5 * std::log2(modulus);
+	return (float)(iter + 1 - std::log(log2_modulus) / log_order);
+}
+
+// Same as escape_time, but also gives the smooth count of the point
+template <typename Kernel>
+inline int escape_time_smooth(const Kernel &kernel, double cr, double ci, int iter_max, double log_order,
+							  float &smooth)
+{
+	double zr = cr;
+	double zi = ci;
+	int iter = 0;
+
+	while (zr * zr + zi * zi < 4.0 && iter < iter_max)
+	{
+		kernel(zr, zi, cr, ci);
+		iter++;
+	}
+
+	smooth = smooth_iteration_count(kernel, iter, zr, zi, cr, ci, iter_max, log_order);
+	return iter;
+}
+
+// Single precision escape time for z^2 + c (Order 2) or z^3 + c (any other Order),
+// in the same operation order as the float SIMD loops so the two agree
+template <int Order>
+inline int escape_time_float(float cr, float ci, int iter_max, float &zr, float &zi)
+{
+	zr = cr;
+	zi = ci;
+	int iter = 0;
+
+	while (zr * zr + zi * zi < 4.0f && iter < iter_max)
+	{
+		if (2 == Order)
+		{
+			float zr2 = zr * zr;
+			float zi2 = zi * zi;
+			zi = 2.0f * zr * zi + ci;
+			zr = zr2 - zi2 + cr;
+		}
+		else
+		{
+			float wr = zr * zr - zi * zi;
+			float wi = zr * zi + zi * zr;
+			float tr = wr * zr - wi * zi;
+			float ti = wr * zi + wi * zr;
+			zr = tr + cr;
+			zi = ti + ci;
+		}
+		iter++;
+	}
+	return iter;
+}
+
+// Works out whether a user supplied function is one we have a specialised
+// kernel for, by comparing it against the kernels on a handful of sample points.
+// Returns CUSTOM_FORMULA if it doesn't match any of them exactly.
+mandel_formula identify_formula(const std::function<Complex(Complex, Complex)> &mandel_func);
+
+// Formula named "first", "third" or by the order of a multibrot z^N + c, as used
+// by batch files and the command line. False for anything else.
+bool parse_formula(const std::string &name, mandel_formula &formula, int &order);
+
+#endif
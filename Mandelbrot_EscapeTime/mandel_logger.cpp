@@ -9,6 +9,10 @@
 #if defined(WIN32) || defined(_WIN32)
 #include <Windows.h>
 #include <stdio.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__unix__)
+#include <sys/resource.h>
 #endif
 
 using namespace std;
@@ -67,6 +71,25 @@ void mandel_logger::add_logfile_detail(string log_detail)
 		m_details_outstanding = true;
 }
 
+long mandel_logger::get_peak_rss_kb(void)
+{
+#if defined(__unix__)
+	//ru_maxrss is already in kB on Linux
+	struct rusage usage;
+	if (0 == getrusage(RUSAGE_SELF, &usage))
+	{
+		return usage.ru_maxrss;
+	}
+#elif defined(_WIN32) || defined(WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return (long)(counters.PeakWorkingSetSize / 1024);
+	}
+#endif
+	return -1;
+}
+
 //Write the m_logfile_details to the provided path, if path is not provided 
 //Writes instead to the permalog & altlog if there is one
 bool mandel_logger::write_logdetails_to_path(string logpath)
@@ -99,6 +99,10 @@ public:
 	//Adds a single string detail to m_logfile_details, used for most of the fractal 
 	//generation details that we don't need to store in this class 
 	void add_logfile_detail(string log_detail);
+
+	//Largest resident set size this process has reached so far in kB, -1 if the
+	//platform can't tell us
+	static long get_peak_rss_kb(void);
 	
 
 	/************************************************
@@ -4,12 +4,21 @@
 
 #include "mandel_plotter.hpp"
 #include "mandel_logger.hpp"
+#include "mandel_simd.hpp"
 
 #include <tuple>
 #include <vector>
+#include <algorithm>
+#include <deque>
 #include <functional>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
 #include <omp.h>
 
 #if defined(__unix__)
@@ -18,12 +27,91 @@
 
 #define DEFAULT_MAX_ITERATIONS 800
 
+//Edge length of the square tiles handed to the work-stealing scheduler
+#define DEFAULT_TILE_SIZE 32
+
+//Rows per band handed out by the dynamic MPI schedule, how many bands each
+//worker is given ahead of time, and the tags used to hand them out
+#define DEFAULT_MPI_BAND_ROWS 16
+#define MPI_BANDS_IN_FLIGHT 2
+#define MPI_TAG_BAND_ASSIGN 10
+#define MPI_TAG_BAND_RESULT 11
+#define MPI_TAG_BAND_SMOOTH 12
+
+//Mariani-Silver subdivision, size of the initial tiles, the smallest interior
+//that is still split, and the smallest area that gets its own OpenMP task
+#define SUBDIVIDE_TILE_SIZE 64
+#define SUBDIVIDE_MIN_SIZE 6
+#define SUBDIVIDE_TASK_AREA 1024
+
+//Pixels handed to the SIMD loop at a time when computing a column
+#define COLUMN_BLOCK_SIZE 64
+
+//Extra references a span may compute for its glitched pixels before giving up on them
+#define PERTURB_MAX_REFERENCES 16
+
+//How far, in pixels of the previous frame, a pixel may be from one of them and still
+//reuse its count. Only has to cover the rounding of the window arithmetic.
+#define REUSE_TOLERANCE 1e-4
+
+//Shortest run of matched pixels worth copying when the row goes through the SIMD
+//loops, anything shorter would just split the vectors on either side of it
+#define REUSE_MIN_RUN 16
+
+//Pixel spacing of the first progressive pass, halved for each pass after it
+#define PROGRESSIVE_FIRST_STEP 4
+
+//Samples across the screen for estimate_iter_max, the rows follow the aspect, and
+//the smallest cap it will pick
+#define AUTO_ITER_SAMPLES 64
+#define AUTO_ITER_MIN 64
+
+//Seed of the jittered sample positions, fixed so a view always antialiases the same way
+#define ANTIALIAS_SEED 20170913
+
 #define MAX_COLOURS_PER_ELEMENT 256
 #define MAX_COLOURS_RGB	16777216  // 256^3 
 
 using namespace std;
 using std::cout;
 
+//Where pixel n of a run goes in the optional smooth channel
+static inline float* smooth_at(float *smooth, size_t n)
+{
+	return (NULL != smooth) ? smooth + n : NULL;
+}
+
+//Smallest multiple of step that is >= value, for the non-negative screen coordinates
+static inline int first_multiple(int value, int step)
+{
+	return ((value + step - 1) / step) * step;
+}
+
+//For each of count pixels along one axis, the pixel of the previous frame it lands on
+//or -1. Pixel n is at offset + n * scale in pixels of the previous frame.
+static vector<int> match_axis(int count, double offset, double scale, int previous_count)
+{
+	vector<int> match(count, -1);
+	for (int n = 0; n < count; ++n)
+	{
+		double position = offset + n * scale;
+		double nearest = floor(position + 0.5);
+		if (fabs(position - nearest) < REUSE_TOLERANCE && nearest >= 0.0 && nearest < previous_count)
+		{
+			match[n] = (int)nearest;
+		}
+	}
+	return match;
+}
+
+#if defined(__unix__)
+//MPI datatype matching each count buffer type
+template <typename T> MPI_Datatype mpi_type_of(void);
+template <> MPI_Datatype mpi_type_of<int>(void) { return MPI_INT; }
+template <> MPI_Datatype mpi_type_of<uint16_t>(void) { return MPI_UNSIGNED_SHORT; }
+template <> MPI_Datatype mpi_type_of<uint32_t>(void) { return MPI_UNSIGNED; }
+#endif
+
 mandel_plotter::mandel_plotter(	window<int> screen,
 								window<double> fractal,
 								int iter_max,
@@ -31,7 +119,74 @@ mandel_plotter::mandel_plotter(	window<int> screen,
 								mandel_logger* logger)
 	:	m_iter_max(iter_max), 
 		m_mandel_func(mandel_func),
+		m_formula(identify_formula(mandel_func)),
+		m_formula_order(2),
+		m_logger(logger)
+{
+	if (THIRD_ORDER == m_formula)
+	{
+		m_formula_order = 3;
+	}
+	init_plotter(screen, fractal);
+}
+
+mandel_plotter::mandel_plotter(	window<int> screen,
+								window<double> fractal,
+								int iter_max,
+								mandel_formula formula,
+								mandel_logger* logger,
+								int order)
+	:	m_iter_max(iter_max),
 		m_logger(logger)
+{
+	select_formula(formula, order);
+	init_plotter(screen, fractal);
+}
+
+void mandel_plotter::select_formula(mandel_formula formula, int order)
+{
+	m_formula = formula;
+	m_formula_order = order;
+
+	//Collapse the multibrot cases we have dedicated kernels for
+	if (MULTIBROT == m_formula && 2 == m_formula_order)
+	{
+		m_formula = FIRST_ORDER;
+	}
+	else if (MULTIBROT == m_formula && 3 == m_formula_order)
+	{
+		m_formula = THIRD_ORDER;
+	}
+	else if (MULTIBROT == m_formula && 2 > m_formula_order)
+	{
+		cout << "Error: multibrot order " << m_formula_order << " is below 2, using first order" << endl;
+		m_formula = FIRST_ORDER;
+		m_formula_order = 2;
+	}
+	else if (FIRST_ORDER == m_formula)
+	{
+		m_formula_order = 2;
+	}
+	else if (THIRD_ORDER == m_formula)
+	{
+		m_formula_order = 3;
+	}
+	else if (CUSTOM_FORMULA == m_formula && !m_mandel_func)
+	{
+		//Nothing to call, so treat it as the standard set
+		cout << "Error: CUSTOM_FORMULA requires a function, using first order" << endl;
+		m_formula = FIRST_ORDER;
+		m_formula_order = 2;
+	}
+	else if (CUSTOM_FORMULA == m_formula)
+	{
+		m_formula_order = 2;
+	}
+
+	m_log_order = log((double)m_formula_order);
+}
+
+void mandel_plotter::init_plotter(window<int> &screen, window<double> &fractal)
 {
 	int rank = -1;
 	int mpi_size = 0;
@@ -43,13 +198,195 @@ mandel_plotter::mandel_plotter(	window<int> screen,
 	m_mpi_rank = rank;
 	m_mpi_size = mpi_size;
 
+	//Pick the widest vector unit this machine supports, can be overridden later
+	m_simd_level = detect_simd_level();
+
+	m_tile_size = DEFAULT_TILE_SIZE;
+	m_mpi_schedule = MPI_SCHEDULE_DYNAMIC;
+	m_mpi_band_rows = DEFAULT_MPI_BAND_ROWS;
+
+	m_verbose = true;
+
+	m_interior_checks = INTERIOR_NONE;
+	m_interior_stats.cardioid = 0;
+	m_interior_stats.periodic = 0;
+
+	m_perturbation = false;
+	m_perturbation_active = false;
+	m_series_approximation = false;
+	m_scalar_type = SCALAR_AUTO;
+	m_active_scalar = SCALAR_DOUBLE;
+	m_float_validation_samples = 0;
+	m_float_validation.sampled = 0;
+	m_float_validation.mismatched = 0;
+	m_float_validation.max_difference = 0;
+	m_orbit_saving = false;
+	m_orbits_active = false;
+	m_saved_orbits.iter_max = 0;
+	m_perturbation_stats.references = 0;
+	m_perturbation_stats.glitched = 0;
+	m_perturbation_stats.unresolved = 0;
+	m_perturbation_stats.skipped = 0;
+
+	//Divisor of the smooth count, custom formulas are treated as order 2
+	m_log_order = log((double)m_formula_order);
+
+	set_screen(screen);
+	set_window(fractal);
+}
+
+void mandel_plotter::set_screen(window<int> &screen)
+{
 	m_screen_width = screen.width();
 	m_screen_height = screen.height();
 	m_screen_y_min = screen.get_y_min();
 	m_screen_y_max = screen.get_y_max();
 	m_screen_x_min = screen.get_x_min();
 	m_screen_x_max = screen.get_x_max();
-		
+
+	m_reference_x = m_screen_x_min + (m_screen_width - 1) / 2.0;
+	m_reference_y = m_screen_y_min + (m_screen_height - 1) / 2.0;
+}
+
+// Keeps everything that was set on the plotter (threads, tiles, interior checks, MPI
+// schedule, scalar type), only what describes the view changes
+void mandel_plotter::set_view(window<int> screen, window<double> fractal, int iter_max, mandel_formula formula,
+							  int order)
+{
+	select_formula(formula, order);
+	set_screen(screen);
+	set_window(fractal);
+	set_iter_max(iter_max);
+}
+
+mandel_plotter::~mandel_plotter()
+{
+}
+
+void mandel_plotter::set_iter_max(int iter_max)
+{
+	if (iter_max > 0)
+	{
+		m_iter_max = iter_max;
+	}
+}
+
+int mandel_plotter::get_iter_max(void)
+{
+	return m_iter_max;
+}
+
+void mandel_plotter::set_simd_level(simd_level level)
+{
+	//Never go wider than the hardware actually supports
+	if (level > detect_simd_level())
+	{
+		level = detect_simd_level();
+	}
+	m_simd_level = level;
+}
+
+simd_level mandel_plotter::get_simd_level(void)
+{
+	return m_simd_level;
+}
+
+void mandel_plotter::set_tile_size(int tile_size)
+{
+	if (0 < tile_size)
+	{
+		m_tile_size = tile_size;
+	}
+}
+
+void mandel_plotter::set_num_threads(int num_threads)
+{
+	m_scheduler.set_num_threads(num_threads);
+}
+
+void mandel_plotter::set_mpi_schedule(mpi_schedule_type schedule, int band_rows)
+{
+	m_mpi_schedule = schedule;
+	if (0 < band_rows)
+	{
+		m_mpi_band_rows = band_rows;
+	}
+}
+
+void mandel_plotter::set_interior_checks(int checks)
+{
+	m_interior_checks = checks;
+}
+
+interior_stats mandel_plotter::get_interior_stats(void)
+{
+	return m_interior_stats;
+}
+
+void mandel_plotter::set_perturbation(bool enabled)
+{
+	m_perturbation = enabled;
+}
+
+void mandel_plotter::set_series_approximation(bool enabled)
+{
+	m_series_approximation = enabled;
+}
+
+void mandel_plotter::set_scalar_type(scalar_type type)
+{
+	m_scalar_type = type;
+}
+
+void mandel_plotter::set_float_validation(int samples)
+{
+	m_float_validation_samples = samples;
+}
+
+float_validation_stats mandel_plotter::get_float_validation(void)
+{
+	return m_float_validation;
+}
+
+void mandel_plotter::set_orbit_saving(bool enabled)
+{
+	m_orbit_saving = enabled;
+}
+
+bool mandel_plotter::set_centre(const std::string &real, const std::string &imaginary, double width)
+{
+	fixed_point check;
+	if (!fixed_point::from_string(real, 2, check) || !fixed_point::from_string(imaginary, 2, check) || !(width > 0.0))
+	{
+		cout << "Error: invalid centre " << real << " + " << imaginary << "i, width " << width << endl;
+		return false;
+	}
+	m_centre_real = real;
+	m_centre_imaginary = imaginary;
+
+	//Same aspect handling as init_plotter, with the reference pixel on the centre. The
+	//doubles only have to be good enough for the paths that don't use perturbation.
+	m_fractal_width = width;
+	m_fractal_height = width * m_screen_height / m_screen_width;
+	m_real_factor = m_fractal_width / (m_screen_width - 1);
+	m_imaginary_factor = m_fractal_height / (m_screen_height - 1);
+	m_fractal_min_real = strtod(real.c_str(), NULL) - m_reference_x * m_real_factor;
+	m_fractal_max_real = m_fractal_min_real + m_fractal_width;
+	m_fractal_max_imaginary = strtod(imaginary.c_str(), NULL) + m_reference_y * m_imaginary_factor;
+	m_fractal_min_imaginary = m_fractal_max_imaginary - m_fractal_height;
+	return true;
+}
+
+perturbation_stats mandel_plotter::get_perturbation_stats(void)
+{
+	return m_perturbation_stats;
+}
+
+void mandel_plotter::set_window(window<double> fractal)
+{
+	m_centre_real.clear();
+	m_centre_imaginary.clear();
+
 	m_fractal_min_real = fractal.get_x_min();
 	m_fractal_max_real = fractal.get_x_max();
 	m_fractal_min_imaginary = fractal.get_y_min();
@@ -64,8 +401,38 @@ mandel_plotter::mandel_plotter(	window<int> screen,
 	m_imaginary_factor = (m_fractal_max_imaginary - m_fractal_min_imaginary) / (m_screen_height - 1);
 }
 
-mandel_plotter::~mandel_plotter()
+window<double> mandel_plotter::get_window(void)
+{
+	return window<double>(m_fractal_min_real, m_fractal_max_real, m_fractal_min_imaginary, m_fractal_max_imaginary);
+}
+
+std::string mandel_plotter::get_cache_key(parallelisation_type parallel_type)
 {
+	if (CUSTOM_FORMULA == m_formula)
+	{
+		return "";
+	}
+
+	//17 digits round trip a double exactly
+	ostringstream key;
+	key << setprecision(17);
+	key << "window " << m_fractal_min_real << " " << m_fractal_max_real << " "
+		<< m_fractal_min_imaginary << " " << m_fractal_max_imaginary
+		<< " screen " << m_screen_width << "x" << m_screen_height << "+" << m_screen_x_min << "+" << m_screen_y_min
+		<< " iter_max " << m_iter_max
+		<< " formula " << (int)m_formula << " order " << m_formula_order
+		<< " scalar " << scalar_type_name(m_scalar_type);
+	if (m_perturbation)
+	{
+		key << " perturbation " << m_centre_real << " " << m_centre_imaginary
+			<< " series " << (m_series_approximation ? 1 : 0);
+	}
+	//Subdivision fills rectangles from their borders, which can differ in a few pixels
+	if (SUBDIVIDE_PARALLEL == parallel_type)
+	{
+		key << " subdivide " << m_tile_size;
+	}
+	return key.str();
 }
 
 // Convert a pixel coordinate to the complex domain using a complex of the form Complex(x,y)
@@ -83,279 +450,1797 @@ Complex mandel_plotter::pixel_to_complex(unsigned int x, unsigned int y)
 }
 
 // Check if a point is in the set or escapes to infinity, return the number of iterations
+// This selects the kernel on every call, so the render loops use escape_time directly
 int mandel_plotter::check_value_within_set(Complex c) {
-	Complex z(c);
-	int iter = 0;
+	switch (m_formula)
+	{
+	case FIRST_ORDER:
+		return escape_time(first_order_kernel(), c.real(), c.imag(), m_iter_max);
+	case THIRD_ORDER:
+		return escape_time(third_order_kernel(), c.real(), c.imag(), m_iter_max);
+	case MULTIBROT:
+		return escape_time(multibrot_kernel(m_formula_order), c.real(), c.imag(), m_iter_max);
+	default:
+		return escape_time(custom_kernel(m_mandel_func), c.real(), c.imag(), m_iter_max);
+	}
+}
 
-	//This is where we apply the desired mandelbrot function and check the 
-	//abs(solute) value of our complex to ensure it is still within range
-	while (abs(z) < 2.0 && iter < m_iter_max) {
-		z = m_mandel_func(z, c);
-		iter++;
+// Select the kernel once for the whole render, then run the specialised loops
+template <typename CountT>
+void mandel_plotter::get_number_iterations(std::vector<CountT> &colours, parallelisation_type parallel_type,
+										   std::vector<float> *smooth)
+{
+	float *smooth_out = NULL;
+	if (NULL != smooth)
+	{
+		smooth->resize(colours.size());
+		smooth_out = &(*smooth)[0];
 	}
 
-	return iter;
+	switch (m_formula)
+	{
+	case FIRST_ORDER:
+		get_number_iterations(colours, parallel_type, first_order_kernel(), smooth_out);
+		break;
+	case THIRD_ORDER:
+		get_number_iterations(colours, parallel_type, third_order_kernel(), smooth_out);
+		break;
+	case MULTIBROT:
+		get_number_iterations(colours, parallel_type, multibrot_kernel(m_formula_order), smooth_out);
+		break;
+	default:
+		get_number_iterations(colours, parallel_type, custom_kernel(m_mandel_func), smooth_out);
+		break;
+	}
 }
 
-// Loop over each pixel from our image and check if the points associated with this pixel escape to infinity
-void mandel_plotter::get_number_iterations(std::vector<int> &colours, parallelisation_type parallel_type)
+// Scalar escape time for a single pixel with the enabled interior shortcuts. The
+// fractional count needs the final z, so periodicity checking is skipped when
+// smooth is wanted (a cycle never gives us one).
+template <typename Kernel>
+inline int mandel_plotter::escape_pixel(const Kernel &kernel, double cr, double ci, float *smooth, interior_stats &stats)
 {
-	int colour_index = 0;
-	if (NO_PARALLEL == parallel_type)
+	if (0 != (m_interior_checks & INTERIOR_CARDIOID) && Kernel::known_interior(cr, ci))
 	{
-		cout << "Using sequential Mandelbrot" << endl;
-		for (int i = m_screen_y_min; i < m_screen_y_max; ++i) 
+		stats.cardioid++;
+		if (NULL != smooth)
 		{
-			for (int j = m_screen_x_min; j < m_screen_x_max; ++j) 
-			{
-
-				Complex c((double)j, (double)i); //Assign real(j) and imaginary(i) coord positions
-				c = pixel_to_complex(c); //convert to complex domain
-
-										 //returns the number of iterations of our complex C 
-										 //and assigns it to the appropriate colours index
-				colours[colour_index] = check_value_within_set(c);
-				++colour_index;
-			}
-			/* May Reenable this given particular fractal parameters
-			if (progress < (int)(i*100.0 / m_screen.get_y_max())) {
-			progress = (int)(i*100.0 / m_screen.get_y_max());
-			std::cout << progress << "%\n";
-			}
-			*/
+			*smooth = (float)m_iter_max;
 		}
+		return m_iter_max;
 	}
-	else if( OMP_PARALLEL == parallel_type)
+
+	if (NULL != smooth)
 	{
-		cout << "Using OpenMP parallelised Mandelbrot" << endl;
-		//Unfortunately OpenMP version on Visual studio doesn't support the collapse clause 
-		//So check at uni but using workaround for now
+		return escape_time_smooth(kernel, cr, ci, m_iter_max, m_log_order, *smooth);
+	}
 
-		omp_set_num_threads(16);
-#pragma omp parallel for private(colour_index) schedule(dynamic, 1)
-		for (int y = m_screen_y_min; y < m_screen_y_max; ++y) 
+	if (0 != (m_interior_checks & INTERIOR_PERIODICITY))
+	{
+		bool cycle_found = false;
+		int iter = escape_time_periodic(kernel, cr, ci, m_iter_max, cycle_found);
+		if (cycle_found)
 		{
-			//cout << "Number of threads = " << omp_get_num_threads() << endl;
-			for (int x = m_screen_x_min; x < m_screen_x_max; ++x)
-			{
-				//for Row-major ordering the offset is calculated as (row * NumColumns )+ column
-				colour_index = y * m_screen_width + x;
-				//Complex c((double)x, (double)y); //Assign two coordinate positions to complex
-				Complex c = pixel_to_complex(x, y); //convert to complex domain
-
-													//returns the number of iterations of our complex C 
-													//and assigns it to the appropriate colours index
-				colours[colour_index] = check_value_within_set(c);
-			}
-			/* May Reenable this given particular fractal parameters
-			if (progress < (int)(i*100.0 / m_screen.get_y_max())) {
-			progress = (int)(i*100.0 / m_screen.get_y_max());
-			std::cout << progress << "%\n";
-			}
-			*/
+			stats.periodic++;
 		}
+		return iter;
 	}
-	else if (MPI_PARALLEL == parallel_type)
-	{
-		//Divide size of colours vector by number of MPI instances to get 
-		//Boundaries for each instance of MPI program to work on 
-		int mpincrement = 0;
-		int index = 0;
 
-		mpincrement = colours.size() / m_mpi_size;
-		int *mpi_colours = new int[mpincrement];
+	return escape_time(kernel, cr, ci, m_iter_max);
+}
 
-		//Output the buffer boundaries during testing (this could also go to logger)
-		cout << "Size of entire buffer: " << m_screen_height * m_screen_width << endl;
-		cout << "Increment size of buffer: " << mpincrement << endl;
+// escape_pixel for the single precision path, for kernels with a simd_order.
+// c is rounded to float just like the SIMD loops do.
+template <typename Kernel>
+inline int mandel_plotter::escape_pixel_float(const Kernel &kernel, double cr, double ci, float *smooth,
+											  interior_stats &stats)
+{
+	const int Order = Kernel::simd_order;
+	float fr = (float)cr;
+	float fi = (float)ci;
+	if (2 == Order && 0 != (m_interior_checks & INTERIOR_CARDIOID) && in_cardioid_or_bulb(fr, fi))
+	{
+		stats.cardioid++;
+		if (NULL != smooth)
+		{
+			*smooth = (float)m_iter_max;
+		}
+		return m_iter_max;
+	}
 
-		//define the boundary based on the MPI instance rank
-		//bounds low = x * S/N
-		//bounds high = ((x+1) * S/N) - 1 
-		size_t buf_bounds_low = m_mpi_rank * mpincrement;
-		size_t buf_bounds_high = ((m_mpi_rank + 1) * mpincrement) - 1;
+	float zr, zi;
+	int iter = escape_time_float<Order>(fr, fi, m_iter_max, zr, zi);
+	if (NULL != smooth)
+	{
+		*smooth = smooth_iteration_count(kernel, iter, zr, zi, fr, fi, m_iter_max, m_log_order);
+	}
+	return iter;
+}
 
-		cout << "Rank: " << m_mpi_rank << " Using MPI only Mandelbrot" << endl;
-		cout << "Lower boundary: " << buf_bounds_low << " , Upper boundary: " << buf_bounds_high << endl;
+// Compute the iterations for the pixels [x_begin, x_end) of row y, using the
+// vector units if there is a SIMD loop for this kernel. smooth is NULL unless
+// the fractional counts are wanted as well.
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_span(const Kernel &kernel, int y, int x_begin, int x_end, CountT *out, float *smooth)
+{
+	if (m_perturbation_active)
+	{
+		perturb_rect(x_begin, x_end, y, y + 1, out, smooth, 0);
+		return;
+	}
+	if (SCALAR_DOUBLE != m_active_scalar && SCALAR_FLOAT != m_active_scalar)
+	{
+		extended_rect(x_begin, x_end, y, y + 1, out, smooth, 0);
+		return;
+	}
 
-		for (int i = buf_bounds_low; i < buf_bounds_high; ++i)
-		{
-			int x = i % m_screen_x_max;
-			int y = (i - x) / m_screen_x_max;
+	if (m_orbits_active)
+	{
+		orbit_span(kernel, y, x_begin, x_end, out, smooth);
+		return;
+	}
 
-			Complex c = pixel_to_complex(x, y); //convert to complex domain
+	double ci = m_fractal_max_imaginary - y * m_imaginary_factor;
+	interior_stats stats = { 0, 0 };
 
-												//returns the number of iterations of our complex C
-												//and assigns it to the appropriate colours index
-			mpi_colours[index] = check_value_within_set(c);
-			index++;
+	if (SCALAR_FLOAT == m_active_scalar)
+	{
+		if (!(SIMD_SCALAR != m_simd_level &&
+			  simd_escape_span_float(m_simd_level, Kernel::simd_order, m_fractal_min_real, m_real_factor,
+									 x_begin, ci, x_end - x_begin, m_iter_max, m_interior_checks, out, stats, smooth)))
+		{
+			for (int x = x_begin; x < x_end; ++x)
+			{
+				double cr = m_fractal_min_real + x * m_real_factor;
+				*out++ = (CountT)escape_pixel_float(kernel, cr, ci, smooth_at(smooth, x - x_begin), stats);
+			}
 		}
-
-		//Now Either Send or receive data to combine into master data container
-		if (0 != m_mpi_rank) //If not master send data to master
+	}
+	else if (0 != Kernel::simd_order && SIMD_SCALAR != m_simd_level &&
+		simd_escape_span(m_simd_level, Kernel::simd_order, m_fractal_min_real, m_real_factor,
+						 x_begin, ci, x_end - x_begin, m_iter_max, m_interior_checks, out, stats, smooth))
+	{
+		//Done
+	}
+	else if (INTERIOR_NONE == m_interior_checks && NULL == smooth)
+	{
+		for (int x = x_begin; x < x_end; ++x)
 		{
-#if defined(__unix__)
-
-			MPI_Send(&mpi_colours[0],	//Buffer 
-				mpincrement,				//Amount of data to send
-				MPI_INT,			 		//data type
-				0,							//Destination (master)
-				0,							//Tag (don't need one)
-				MPI_COMM_WORLD);
-			
-			cout << "Send call from rank " << m_mpi_rank << endl;
-#endif
+			*out++ = (CountT)escape_time(kernel, m_fractal_min_real + x * m_real_factor, ci, m_iter_max);
 		}
-		else //Master, receive data and allocate to colours vector
+	}
+	else
+	{
+		for (int x = x_begin; x < x_end; ++x)
 		{
-#if defined(__unix__)
-			index = 0;
-			for (int b = buf_bounds_low; b < buf_bounds_high; b++)
-			{
-				colours[b] = mpi_colours[index];
-				index++;
-			}
-
-			for (int t = 1; t < m_mpi_size; t++)
-			{ 
-				MPI_Status status;
-				size_t rcv_rank;
+			double cr = m_fractal_min_real + x * m_real_factor;
+			*out++ = (CountT)escape_pixel(kernel, cr, ci, smooth_at(smooth, x - x_begin), stats);
+		}
+	}
 
-				MPI_Recv(&mpi_colours[0],		//buffer
-					mpincrement,				//Amount of data to recv
-					MPI_INT,					//Data type
-					MPI_ANY_SOURCE,				//source
-					0,							//Tag
-					MPI_COMM_WORLD,				//Comm
-					&status);					//status
+	if (INTERIOR_NONE != m_interior_checks)
+	{
+#pragma omp atomic
+		m_interior_stats.cardioid += stats.cardioid;
+#pragma omp atomic
+		m_interior_stats.periodic += stats.periodic;
+	}
+}
 
-				rcv_rank = status.MPI_SOURCE;
-				cout << "Master Receive call from rank " << rcv_rank << endl;
+// Same results as compute_span on the double path, but z is kept for the pixels
+// that reach the cap. Those are collected per span and appended in one go.
+template <typename Kernel, typename CountT>
+void mandel_plotter::orbit_span(const Kernel &kernel, int y, int x_begin, int x_end, CountT *out, float *smooth)
+{
+	const int count = x_end - x_begin;
+	const bool periodic = 0 != (m_interior_checks & INTERIOR_PERIODICITY);
+	const double nan = numeric_limits<double>::quiet_NaN();
+	double ci = m_fractal_max_imaginary - y * m_imaginary_factor;
+	interior_stats stats = { 0, 0 };
+	vector<double> final_z(2 * (size_t)count);
 
-				//Get boundaries for sender 
-				size_t rcvbuf_bounds_low = rcv_rank * mpincrement;
-				size_t rcvbuf_bounds_high = ((rcv_rank + 1) * mpincrement) - 1;
+	if (!(0 != Kernel::simd_order && SIMD_SCALAR != m_simd_level &&
+		  simd_escape_span(m_simd_level, Kernel::simd_order, m_fractal_min_real, m_real_factor, x_begin, ci, count,
+						   m_iter_max, m_interior_checks, out, stats, smooth, &final_z[0])))
+	{
+		for (int n = 0; n < count; ++n)
+		{
+			double cr = m_fractal_min_real + (x_begin + n) * m_real_factor;
+			double zr = cr;
+			double zi = ci;
+			bool cycle_found = false;
+			int iter = m_iter_max;
 
-				int index = 0;
-				//Now copy this to the main colours vector
-				for (int b = rcvbuf_bounds_low; b < rcvbuf_bounds_high; b++)
+			if (0 != (m_interior_checks & INTERIOR_CARDIOID) && Kernel::known_interior(cr, ci))
+			{
+				stats.cardioid++;
+				zr = nan;
+			}
+			else
+			{
+				iter = periodic ? escape_time_from<true>(kernel, cr, ci, 0, m_iter_max, zr, zi, cycle_found) :
+								  escape_time_from<false>(kernel, cr, ci, 0, m_iter_max, zr, zi, cycle_found);
+				if (cycle_found)
 				{
-					colours[b] = mpi_colours[index];
-					index++;
+					stats.periodic++;
+					zr = nan;
 				}
 			}
-#endif
+
+			out[n] = (CountT)iter;
+			if (NULL != smooth)
+			{
+				smooth[n] = smooth_iteration_count(kernel, iter, zr, zi, cr, ci, m_iter_max, m_log_order);
+			}
+			final_z[2 * n] = zr;
+			final_z[2 * n + 1] = zi;
 		}
-		
 	}
-	else if (BOTH_PARALLEL == parallel_type)
-	{
-		//Divide size of colours vector by number of MPI instances to get 
-		//Boundaries for each instance of MPI program to work on 
-		int mpincrement = 0;
-		int mpi_comm_size = 0;
-		int index = 0;
-
-#if defined(__unix__)
-		MPI_Comm_size(MPI_COMM_WORLD, &mpi_comm_size);
-#endif
-
-		mpincrement = colours.size() / mpi_comm_size;
-		int *mpi_colours = new int[mpincrement];
-
-		//Output the buffer boundaries during testing (this could also go to logger)
-		cout << "Size of entire buffer: " << m_screen_height * m_screen_width << endl;
-		cout << "Increment size of buffer: " << mpincrement << endl;
 
-		//define the boundary based on the MPI instance rank
-		//bounds low = x * S/N
-		//bounds high = ((x+1) * S/N) - 1
-		size_t buf_bounds_low = m_mpi_rank * mpincrement;
-		size_t buf_bounds_high = ((m_mpi_rank + 1) * mpincrement) - 1;
-
-		cout << "Rank: " << m_mpi_rank << " Using MPI only Mandelbrot" << endl;
-		cout << "Lower boundary: " << buf_bounds_low << " , Upper boundary: " << buf_bounds_high << endl;
-
-#pragma omp parallel for private(index)
-		for (int i = buf_bounds_low; i < buf_bounds_high; ++i)
+	//NaN marks the pixels an interior check settled, they are final already
+	size_t row_first = (size_t)(y - m_screen_y_min) * m_screen_width + (x_begin - m_screen_x_min);
+	vector<size_t> pixels;
+	vector<double> z;
+	for (int n = 0; n < count; ++n)
+	{
+		if ((int)out[n] == m_iter_max && !std::isnan(final_z[2 * n]))
 		{
-			int x = i % m_screen_x_max;
-			int y = (i - x) / m_screen_x_max;
-
-			Complex c = pixel_to_complex(x, y); //convert to complex domain
-
-												//returns the number of iterations of our complex C
-												//and assigns it to the appropriate colours index
-			mpi_colours[index] = check_value_within_set(c);
-			index++;
+			pixels.push_back(row_first + n);
+			z.push_back(final_z[2 * n]);
+			z.push_back(final_z[2 * n + 1]);
 		}
-
-		//Now Either Send or receive data to combine into master data container
-		if (0 != m_mpi_rank) //If not master send data to master
+	}
+	if (!pixels.empty())
+	{
+#pragma omp critical(saved_orbits)
 		{
+			m_saved_orbits.pixels.insert(m_saved_orbits.pixels.end(), pixels.begin(), pixels.end());
+			m_saved_orbits.z.insert(m_saved_orbits.z.end(), z.begin(), z.end());
+		}
+	}
+
+	if (INTERIOR_NONE != m_interior_checks)
+	{
+#pragma omp atomic
+		m_interior_stats.cardioid += stats.cardioid;
+#pragma omp atomic
+		m_interior_stats.periodic += stats.periodic;
+	}
+}
+
+// The saved pixels are independent of each other and nearly all of them are
+// interior ones that run to the new cap, so they are simply split between the
+// threads. The ones that escape (or turn out to cycle) are dropped afterwards.
+template <typename Kernel, typename CountT>
+void mandel_plotter::extend_orbits(const Kernel &kernel, std::vector<CountT> &colours, std::vector<float> *smooth,
+								   parallelisation_type parallel_type, int previous_iter_max)
+{
+	const long long num_saved = (long long)m_saved_orbits.pixels.size();
+	const bool periodic = 0 != (m_interior_checks & INTERIOR_PERIODICITY);
+	const double nan = numeric_limits<double>::quiet_NaN();
+	long long cycles = 0;
+
+#pragma omp parallel for schedule(dynamic, 64) num_threads(m_scheduler.get_num_threads()) reduction(+:cycles) \
+	if (OMP_PARALLEL == parallel_type)
+	for (long long n = 0; n < num_saved; ++n)
+	{
+		size_t pixel = m_saved_orbits.pixels[n];
+		double cr = m_fractal_min_real + (m_screen_x_min + (int)(pixel % m_screen_width)) * m_real_factor;
+		double ci = m_fractal_max_imaginary - (m_screen_y_min + (int)(pixel / m_screen_width)) * m_imaginary_factor;
+		double &zr = m_saved_orbits.z[2 * n];
+		double &zi = m_saved_orbits.z[2 * n + 1];
+		bool cycle_found = false;
+
+		int iter = periodic ? escape_time_from<true>(kernel, cr, ci, previous_iter_max, m_iter_max, zr, zi, cycle_found) :
+							  escape_time_from<false>(kernel, cr, ci, previous_iter_max, m_iter_max, zr, zi, cycle_found);
+		colours[pixel] = (CountT)iter;
+		if (NULL != smooth)
+		{
+			(*smooth)[pixel] = smooth_iteration_count(kernel, iter, zr, zi, cr, ci, m_iter_max, m_log_order);
+		}
+		if (cycle_found)
+		{
+			cycles++;
+		}
+		if (cycle_found || iter < m_iter_max)
+		{
+			zr = nan;
+		}
+	}
+
+	size_t remaining = 0;
+	for (size_t n = 0; n < m_saved_orbits.pixels.size(); ++n)
+	{
+		if (!std::isnan(m_saved_orbits.z[2 * n]))
+		{
+			m_saved_orbits.pixels[remaining] = m_saved_orbits.pixels[n];
+			m_saved_orbits.z[2 * remaining] = m_saved_orbits.z[2 * n];
+			m_saved_orbits.z[2 * remaining + 1] = m_saved_orbits.z[2 * n + 1];
+			remaining++;
+		}
+	}
+	m_saved_orbits.pixels.resize(remaining);
+	m_saved_orbits.z.resize(2 * remaining);
+	m_interior_stats.periodic += cycles;
+
+	if (m_verbose)
+	{
+		cout << "Carried " << num_saved << " pixels on from " << previous_iter_max << " to " << m_iter_max
+			 << " iterations, " << remaining << " of them are still at the cap" << endl;
+	}
+}
+
+// A row without a match is computed whole, any other row copies its matched pixels
+// and computes the runs in between. With the SIMD loops single matched pixels (an
+// integer zoom in) cost more to step around than to recompute, so only the longer
+// runs a pan or zoom out gives are copied then.
+template <typename Kernel, typename CountT>
+long long mandel_plotter::reuse_rows(const Kernel &kernel, parallelisation_type parallel_type,
+									 std::vector<CountT> &colours, float *smooth, const std::vector<CountT> &previous,
+									 const float *previous_smooth, const std::vector<int> &match_x,
+									 const std::vector<int> &match_y)
+{
+	long long reused = 0;
+	const int min_run = (0 != Kernel::simd_order && SIMD_SCALAR != m_simd_level &&
+						 (SCALAR_DOUBLE == m_active_scalar || SCALAR_FLOAT == m_active_scalar)) ? REUSE_MIN_RUN : 1;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(m_scheduler.get_num_threads()) reduction(+:reused) \
+	if (OMP_PARALLEL == parallel_type)
+	for (int row = 0; row < m_screen_height; ++row)
+	{
+		size_t offset = (size_t)row * m_screen_width;
+		int y = m_screen_y_min + row;
+		if (match_y[row] < 0)
+		{
+			compute_span(kernel, y, m_screen_x_min, m_screen_x_max, &colours[offset], smooth_at(smooth, offset));
+			continue;
+		}
+
+		size_t previous_offset = (size_t)match_y[row] * m_screen_width;
+		int column = 0;
+		while (column < m_screen_width)
+		{
+			int run_end = column;
+			while (run_end < m_screen_width && match_x[run_end] >= 0)
+			{
+				run_end++;
+			}
+			if (run_end - column >= min_run)
+			{
+				reused += run_end - column;
+				for (; column < run_end; ++column)
+				{
+					colours[offset + column] = previous[previous_offset + match_x[column]];
+					if (NULL != smooth)
+					{
+						smooth[offset + column] = previous_smooth[previous_offset + match_x[column]];
+					}
+				}
+				continue;
+			}
+
+			//Compute up to the next run that is long enough to copy
+			int span_end = run_end;
+			while (span_end < m_screen_width)
+			{
+				if (match_x[span_end] < 0)
+				{
+					span_end++;
+					continue;
+				}
+				int next = span_end;
+				while (next < m_screen_width && match_x[next] >= 0)
+				{
+					next++;
+				}
+				if (next - span_end >= min_run)
+				{
+					break;
+				}
+				span_end = next;
+			}
+			compute_span(kernel, y, m_screen_x_min + column, m_screen_x_min + span_end, &colours[offset + column],
+						 smooth_at(smooth, offset + column));
+			column = span_end;
+		}
+	}
+	return reused;
+}
+
+// The rows that fall between the rows of the last pass are spans of pixels step apart,
+// the rest of the new pixels are on its rows, in columns twice the step apart. Scaling
+// a factor by a power of two and dividing the coordinates (and the reference pixel)
+// by it leaves every c exactly as the full resolution render has it, so both of them
+// go through compute_span / compute_column and the vector loops unchanged.
+template <typename Kernel, typename CountT>
+void mandel_plotter::progressive_pass(const Kernel &kernel, parallelisation_type parallel_type, int step,
+									  bool first_pass, std::vector<CountT> &colours, float *smooth)
+{
+	const int first_x = first_multiple(m_screen_x_min, step);
+	const int first_y = first_multiple(m_screen_y_min, step);
+	const int num_columns = (m_screen_x_max - first_x + step - 1) / step;
+	const int num_rows = (m_screen_y_max - first_y + step - 1) / step;
+	const double real_factor = m_real_factor;
+	const double imaginary_factor = m_imaginary_factor;
+	const double reference_x = m_reference_x;
+	const double reference_y = m_reference_y;
+	if (num_columns <= 0 || num_rows <= 0)
+	{
+		return;
+	}
+
+	m_real_factor = real_factor * step;
+	m_reference_x = reference_x / step;
+#pragma omp parallel num_threads(m_scheduler.get_num_threads()) if (OMP_PARALLEL == parallel_type)
+	{
+		vector<CountT> row(num_columns);
+		vector<float> row_smooth((NULL != smooth) ? num_columns : 0);
+
+#pragma omp for schedule(dynamic, 1)
+		for (int r = 0; r < num_rows; ++r)
+		{
+			int y = first_y + r * step;
+			if (!first_pass && 0 == y % (2 * step))
+			{
+				continue;
+			}
+
+			compute_span(kernel, y, first_x / step, first_x / step + num_columns, &row[0],
+						 (NULL != smooth) ? &row_smooth[0] : NULL);
+			size_t offset = (size_t)(y - m_screen_y_min) * m_screen_width + (first_x - m_screen_x_min);
+			for (int c = 0; c < num_columns; ++c)
+			{
+				colours[offset + (size_t)c * step] = row[c];
+				if (NULL != smooth)
+				{
+					smooth[offset + (size_t)c * step] = row_smooth[c];
+				}
+			}
+		}
+	}
+	m_real_factor = real_factor;
+	m_reference_x = reference_x;
+
+	if (!first_pass)
+	{
+		const int row_step = 2 * step;
+		const int first_even_y = first_multiple(m_screen_y_min, row_step);
+		const int num_even_rows = (m_screen_y_max - first_even_y + row_step - 1) / row_step;
+
+		m_imaginary_factor = imaginary_factor * row_step;
+		m_reference_y = reference_y / row_step;
+		if (num_even_rows > 0)
+		{
+#pragma omp parallel for schedule(dynamic, 1) num_threads(m_scheduler.get_num_threads()) \
+	if (OMP_PARALLEL == parallel_type)
+			for (int c = 0; c < num_columns; ++c)
+			{
+				int x = first_x + c * step;
+				if (0 == x % row_step)
+				{
+					continue;
+				}
+				size_t offset = (size_t)(first_even_y - m_screen_y_min) * m_screen_width + (x - m_screen_x_min);
+				compute_column(kernel, x, first_even_y / row_step, first_even_y / row_step + num_even_rows,
+							   &colours[offset], smooth_at(smooth, offset), (size_t)row_step * m_screen_width);
+			}
+		}
+		m_imaginary_factor = imaginary_factor;
+		m_reference_y = reference_y;
+	}
+
+	if (1 == step)
+	{
+		return;
+	}
+
+	//Fill in the pixels off the grid for the frame handed out after this pass
+#pragma omp parallel for schedule(static) num_threads(m_scheduler.get_num_threads()) \
+	if (OMP_PARALLEL == parallel_type)
+	for (int y = m_screen_y_min; y < m_screen_y_max; ++y)
+	{
+		int grid_y = std::max(first_y, y - y % step);
+		size_t offset = (size_t)(y - m_screen_y_min) * m_screen_width;
+		size_t grid_offset = (size_t)(grid_y - m_screen_y_min) * m_screen_width;
+		for (int x = m_screen_x_min; x < m_screen_x_max; ++x)
+		{
+			int grid_x = std::max(first_x, x - x % step);
+			if (grid_x == x && grid_y == y)
+			{
+				continue;
+			}
+			colours[offset + (x - m_screen_x_min)] = colours[grid_offset + (grid_x - m_screen_x_min)];
+			if (NULL != smooth)
+			{
+				smooth[offset + (x - m_screen_x_min)] = smooth[grid_offset + (grid_x - m_screen_x_min)];
+			}
+		}
+	}
+}
+
+// Same trick as progressive_pass, with the factors scaled so that consecutive
+// coordinates are a whole grid cell apart, so the samples go through compute_span
+// and get whichever precision or perturbation the render itself would use
+template <typename Kernel>
+void mandel_plotter::sample_grid(const Kernel &kernel, int samples_x, int samples_y, std::vector<int> &counts)
+{
+	const double real_factor = m_real_factor;
+	const double imaginary_factor = m_imaginary_factor;
+	const double reference_x = m_reference_x;
+	const double reference_y = m_reference_y;
+	const double cell_x = (double)(m_screen_width - 1) / (samples_x - 1);
+	const double cell_y = (double)(m_screen_height - 1) / (samples_y - 1);
+	const int first_x = (int)ceil(m_screen_x_min / cell_x);
+	const int first_y = (int)ceil(m_screen_y_min / cell_y);
+
+	m_real_factor = real_factor * cell_x;
+	m_imaginary_factor = imaginary_factor * cell_y;
+	m_reference_x = reference_x / cell_x;
+	m_reference_y = reference_y / cell_y;
+	counts.assign((size_t)samples_x * samples_y, 0);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(m_scheduler.get_num_threads())
+	for (int row = 0; row < samples_y; ++row)
+	{
+		compute_span(kernel, first_y + row, first_x, first_x + samples_x, &counts[(size_t)row * samples_x],
+					 (float*)NULL);
+	}
+
+	m_real_factor = real_factor;
+	m_imaginary_factor = imaginary_factor;
+	m_reference_x = reference_x;
+	m_reference_y = reference_y;
+}
+
+// Moving the window and the reference pixel by the offset moves every c by it on
+// all of the precision paths, so each pass is just compute_span over the runs of
+// picked pixels in every row. The pixels are in row order, so a run of them is a
+// run of consecutive entries in counts as well.
+template <typename Kernel>
+void mandel_plotter::supersample(const Kernel &kernel, bool use_threads, const std::vector<double> &offsets,
+								 antialias_samples &samples)
+{
+	const size_t num_pixels = samples.pixels.size();
+	const bool smooth = !samples.smooth.empty();
+	const double min_real = m_fractal_min_real;
+	const double max_imaginary = m_fractal_max_imaginary;
+	const double reference_x = m_reference_x;
+	const double reference_y = m_reference_y;
+
+	//First entry of each row
+	vector<size_t> row_first(m_screen_height + 1, 0);
+	for (size_t n = 0; n < num_pixels; ++n)
+	{
+		row_first[samples.pixels[n] / m_screen_width + 1]++;
+	}
+	for (int row = 0; row < m_screen_height; ++row)
+	{
+		row_first[row + 1] += row_first[row];
+	}
+
+	for (int k = 0; k < samples.per_pixel; ++k)
+	{
+		double dx = offsets[2 * k];
+		double dy = offsets[2 * k + 1];
+		m_fractal_min_real = min_real + dx * m_real_factor;
+		m_fractal_max_imaginary = max_imaginary - dy * m_imaginary_factor;
+		m_reference_x = reference_x - dx;
+		m_reference_y = reference_y - dy;
+
+		uint32_t *counts = &samples.counts[(size_t)k * num_pixels];
+		float *smooth_out = smooth ? &samples.smooth[(size_t)k * num_pixels] : NULL;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(m_scheduler.get_num_threads()) if (use_threads)
+		for (int row = 0; row < m_screen_height; ++row)
+		{
+			size_t n = row_first[row];
+			while (n < row_first[row + 1])
+			{
+				size_t run_end = n + 1;
+				while (run_end < row_first[row + 1] && samples.pixels[run_end] == samples.pixels[run_end - 1] + 1)
+				{
+					run_end++;
+				}
+				int x = m_screen_x_min + (int)(samples.pixels[n] % m_screen_width);
+				compute_span(kernel, m_screen_y_min + row, x, x + (int)(run_end - n), counts + n,
+							 smooth_at(smooth_out, n));
+				n = run_end;
+			}
+		}
+	}
+
+	m_fractal_min_real = min_real;
+	m_fractal_max_imaginary = max_imaginary;
+	m_reference_x = reference_x;
+	m_reference_y = reference_y;
+}
+
+// Compute the pixels [y_begin, y_end) of column x, writing every stride'th element of out (and smooth)
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_column(const Kernel &kernel, int x, int y_begin, int y_end, CountT *out, float *smooth,
+									size_t stride)
+{
+	if (m_perturbation_active)
+	{
+		perturb_rect(x, x + 1, y_begin, y_end, out, smooth, stride);
+		return;
+	}
+	if (SCALAR_DOUBLE != m_active_scalar && SCALAR_FLOAT != m_active_scalar)
+	{
+		extended_rect(x, x + 1, y_begin, y_end, out, smooth, stride);
+		return;
+	}
+
+	double cr = m_fractal_min_real + x * m_real_factor;
+	interior_stats stats = { 0, 0 };
+	CountT block[COLUMN_BLOCK_SIZE];
+	float smooth_block[COLUMN_BLOCK_SIZE];
+
+	for (int y = y_begin; y < y_end; y += COLUMN_BLOCK_SIZE)
+	{
+		int count = (y_end - y < COLUMN_BLOCK_SIZE) ? y_end - y : COLUMN_BLOCK_SIZE;
+		size_t block_first = (size_t)(y - y_begin) * stride;
+
+		bool vectorised = false;
+		if (0 != Kernel::simd_order && SIMD_SCALAR != m_simd_level)
+		{
+			float *block_smooth = (NULL != smooth) ? smooth_block : NULL;
+			vectorised = (SCALAR_FLOAT == m_active_scalar) ?
+				simd_escape_column_float(m_simd_level, Kernel::simd_order, cr, m_fractal_max_imaginary,
+										 m_imaginary_factor, y, count, m_iter_max, m_interior_checks, block, stats,
+										 block_smooth) :
+				simd_escape_column(m_simd_level, Kernel::simd_order, cr, m_fractal_max_imaginary, m_imaginary_factor,
+								   y, count, m_iter_max, m_interior_checks, block, stats, block_smooth);
+		}
+		if (vectorised && NULL != smooth)
+		{
+			for (int n = 0; n < count; ++n)
+			{
+				smooth[block_first + n * stride] = smooth_block[n];
+			}
+		}
+		else if (!vectorised)
+		{
+			for (int n = 0; n < count; ++n)
+			{
+				double ci = m_fractal_max_imaginary - (y + n) * m_imaginary_factor;
+				float *pixel_smooth = smooth_at(smooth, block_first + n * stride);
+				block[n] = (SCALAR_FLOAT == m_active_scalar) ?
+					(CountT)escape_pixel_float(kernel, cr, ci, pixel_smooth, stats) :
+					(CountT)escape_pixel(kernel, cr, ci, pixel_smooth, stats);
+			}
+		}
+
+		for (int n = 0; n < count; ++n)
+		{
+			out[block_first + n * stride] = block[n];
+		}
+	}
+
+	if (INTERIOR_NONE != m_interior_checks)
+	{
+#pragma omp atomic
+		m_interior_stats.cardioid += stats.cardioid;
+#pragma omp atomic
+		m_interior_stats.periodic += stats.periodic;
+	}
+}
+
+// Every pixel is first iterated against the primary reference, starting from the
+// series where the probes at the corners and centre of the rectangle agree with it
+// (the error is analytic in dc, so it peaks on the edge rather than inside). The glitched ones
+// are then redone against a reference on one of themselves, which can't glitch
+// against its own orbit, so each pass resolves at least that pixel. Secondary
+// references are only computed for the pixels of this span and are thrown away
+// afterwards, which keeps the spans independent of each other.
+template <typename CountT>
+void mandel_plotter::perturb_rect(int x_begin, int x_end, int y_begin, int y_end, CountT *out, float *smooth,
+								  size_t stride)
+{
+	const int width = x_end - x_begin;
+	const int num_pixels = width * (y_end - y_begin);
+	vector<int> glitched;
+	double zr, zi;
+	bool glitch;
+	int skip = 0;
+
+	if (m_series_approximation && 1 < m_reference.series_length())
+	{
+		int probe_x[5] = { x_begin, x_end - 1, x_begin, x_end - 1, (x_begin + x_end - 1) / 2 };
+		int probe_y[5] = { y_begin, y_begin, y_end - 1, y_end - 1, (y_begin + y_end - 1) / 2 };
+		double probe_r[5], probe_i[5];
+		for (int p = 0; p < 5; ++p)
+		{
+			probe_r[p] = (probe_x[p] - m_reference_x) * m_real_factor;
+			probe_i[p] = (m_reference_y - probe_y[p]) * m_imaginary_factor;
+		}
+		skip = m_reference.series_skip(probe_r, probe_i, 5, m_iter_max);
+	}
+
+	auto store = [&](int p, int iter)
+	{
+		size_t offset = (size_t)(p / width) * stride + p % width;
+		out[offset] = (CountT)iter;
+		if (NULL != smooth)
+		{
+			double cr = m_fractal_min_real + (x_begin + p % width) * m_real_factor;
+			double ci = m_fractal_max_imaginary - (y_begin + p / width) * m_imaginary_factor;
+			smooth[offset] = smooth_iteration_count(first_order_kernel(), iter, zr, zi, cr, ci, m_iter_max, m_log_order);
+		}
+	};
+
+	for (int p = 0; p < num_pixels; ++p)
+	{
+		int x = x_begin + p % width;
+		int y = y_begin + p / width;
+		int iter = m_reference.escape((x - m_reference_x) * m_real_factor, (m_reference_y - y) * m_imaginary_factor,
+									  m_iter_max, zr, zi, glitch, skip);
+		if (glitch)
+		{
+			glitched.push_back(p);
+		}
+		else
+		{
+			store(p, iter);
+		}
+	}
+
+	if (0 < skip)
+	{
+		long long skipped = (long long)skip * num_pixels;
+#pragma omp atomic
+		m_perturbation_stats.skipped += skipped;
+	}
+
+	if (glitched.empty())
+	{
+		return;
+	}
+
+	long long glitched_count = (long long)glitched.size();
+	long long references = 0;
+	int limbs = m_reference.get_real().num_limbs();
+	reference_orbit local;
+
+	while (!glitched.empty() && references < PERTURB_MAX_REFERENCES)
+	{
+		int g = glitched[glitched.size() / 2];
+		double gx = x_begin + g % width;
+		double gy = y_begin + g / width;
+		local.compute(m_reference.get_real() + fixed_point::from_double((gx - m_reference_x) * m_real_factor, limbs),
+					  m_reference.get_imaginary() + fixed_point::from_double((m_reference_y - gy) * m_imaginary_factor, limbs),
+					  m_iter_max);
+		references++;
+
+		size_t remaining = 0;
+		for (size_t n = 0; n < glitched.size(); ++n)
+		{
+			int p = glitched[n];
+			int x = x_begin + p % width;
+			int y = y_begin + p / width;
+			int iter = local.escape((x - gx) * m_real_factor, (gy - y) * m_imaginary_factor, m_iter_max, zr, zi, glitch);
+			if (glitch)
+			{
+				glitched[remaining++] = p;
+			}
+			else
+			{
+				store(p, iter);
+			}
+		}
+		glitched.resize(remaining);
+	}
+
+	//Out of references, plain doubles at least give these pixels a count
+	for (size_t n = 0; n < glitched.size(); ++n)
+	{
+		int p = glitched[n];
+		double cr = m_fractal_min_real + (x_begin + p % width) * m_real_factor;
+		double ci = m_fractal_max_imaginary - (y_begin + p / width) * m_imaginary_factor;
+		float fraction;
+		size_t offset = (size_t)(p / width) * stride + p % width;
+		out[offset] = (CountT)escape_time_smooth(first_order_kernel(), cr, ci, m_iter_max, m_log_order, fraction);
+		if (NULL != smooth)
+		{
+			smooth[offset] = fraction;
+		}
+	}
+
+	long long unresolved = (long long)glitched.size();
+#pragma omp atomic
+	m_perturbation_stats.references += references;
+#pragma omp atomic
+	m_perturbation_stats.glitched += glitched_count;
+#pragma omp atomic
+	m_perturbation_stats.unresolved += unresolved;
+}
+
+template <typename CountT>
+void mandel_plotter::extended_rect(int x_begin, int x_end, int y_begin, int y_end, CountT *out, float *smooth,
+								   size_t stride)
+{
+	switch (m_active_scalar)
+	{
+	case SCALAR_LONG_DOUBLE:
+		extended_rect_as<long double>(x_begin, x_end, y_begin, y_end, out, smooth, stride);
+		break;
+#if defined(MANDEL_HAS_FLOAT128)
+	case SCALAR_FLOAT128:
+		extended_rect_as<__float128>(x_begin, x_end, y_begin, y_end, out, smooth, stride);
+		break;
+#endif
+	default:
+		extended_rect_as<double_double>(x_begin, x_end, y_begin, y_end, out, smooth, stride);
+		break;
+	}
+}
+
+// The offsets from the centre are only a few pixels' worth of bits, so they are
+// fine as doubles, it's adding them to the centre that needs the wider type
+template <typename Scalar, typename CountT>
+void mandel_plotter::extended_rect_as(int x_begin, int x_end, int y_begin, int y_end, CountT *out, float *smooth,
+									  size_t stride)
+{
+	const Scalar centre_real = scalar_from_fixed<Scalar>(m_extended_real);
+	const Scalar centre_imaginary = scalar_from_fixed<Scalar>(m_extended_imaginary);
+
+	for (int y = y_begin; y < y_end; ++y)
+	{
+		Scalar ci = centre_imaginary + Scalar((m_reference_y - y) * m_imaginary_factor);
+		size_t row = (size_t)(y - y_begin) * stride;
+		for (int x = x_begin; x < x_end; ++x)
+		{
+			Scalar cr = centre_real + Scalar((x - m_reference_x) * m_real_factor);
+			double zr, zi;
+			int iter = escape_time_scalar(cr, ci, m_iter_max, zr, zi);
+			out[row + x - x_begin] = (CountT)iter;
+			if (NULL != smooth)
+			{
+				smooth[row + x - x_begin] = smooth_iteration_count(first_order_kernel(), iter, zr, zi, scalar_to_double(cr),
+																   scalar_to_double(ci), m_iter_max, m_log_order);
+			}
+		}
+	}
+}
+
+// Compute the pixels [first, last) of the row-major flattened screen, split into
+// row spans so each one still goes through compute_span
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_range(const Kernel &kernel, size_t first, size_t last, CountT *out, float *smooth)
+{
+	if (last <= first)
+	{
+		return;
+	}
+
+	int first_row = (int)(first / m_screen_width);
+	int last_row = (int)((last - 1) / m_screen_width);
+
+	for (int row = first_row; row <= last_row; ++row)
+	{
+		size_t row_start = (size_t)row * m_screen_width;
+		size_t span_first = (row_start > first) ? row_start : first;
+		size_t span_last = (row_start + m_screen_width < last) ? row_start + m_screen_width : last;
+
+		compute_span(kernel,
+					 row + m_screen_y_min,
+					 (int)(span_first - row_start) + m_screen_x_min,
+					 (int)(span_last - row_start) + m_screen_x_min,
+					 out + (span_first - first), smooth_at(smooth, span_first - first));
+	}
+}
+
+// Same as compute_range, but the pixels are split into tiles and run on the
+// work-stealing scheduler
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_tiles(const Kernel &kernel, size_t first, size_t last, CountT *out, float *smooth)
+{
+	vector<tile> tiles;
+	tile_scheduler::make_tiles(first, last, m_screen_width, m_tile_size, tiles);
+
+	m_scheduler.run(tiles, [&](const tile &t)
+	{
+		for (int y = t.y_begin; y < t.y_end; ++y)
+		{
+			size_t offset = (size_t)y * m_screen_width + t.x_begin - first;
+			compute_span(kernel, y + m_screen_y_min, t.x_begin + m_screen_x_min, t.x_end + m_screen_x_min,
+						 out + offset, smooth_at(smooth, offset));
+		}
+	});
+}
+
+// Static MPI schedule. Bands of m_mpi_band_rows rows are dealt round robin, so in
+// round r rank k computes band r * size + k. The bands of one round are contiguous
+// in the image, so a single MPI_Igatherv per round drops every rank's band straight
+// into colours on rank 0 (rank 0 computes its own band in place) while the ranks
+// carry on with the next round. The smooth channel, if any, gets a gather of its own.
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_mpi_static(const Kernel &kernel, std::vector<CountT> &colours, float *smooth,
+										bool use_threads)
+{
+	const size_t band_pixels = (size_t)m_mpi_band_rows * m_screen_width;
+	const int num_bands = (m_screen_height + m_mpi_band_rows - 1) / m_mpi_band_rows;
+	const int mpi_size = (0 < m_mpi_size) ? m_mpi_size : 1;
+	const int rank = (0 < m_mpi_rank) ? m_mpi_rank : 0;
+	const int num_rounds = (num_bands + mpi_size - 1) / mpi_size;
+
+	//Pixels covered by a band, 0 past the end of the image
+	auto band_size = [&](int band) -> size_t
+	{
+		size_t first = (size_t)band * band_pixels;
+		if (first >= colours.size())
+		{
+			return 0;
+		}
+		return (first + band_pixels < colours.size()) ? band_pixels : colours.size() - first;
+	};
+
+	auto compute_band = [&](int band, CountT *out, float *smooth_out)
+	{
+		size_t first = (size_t)band * band_pixels;
+		if (use_threads)
+		{
+			compute_tiles(kernel, first, first + band_size(band), out, smooth_out);
+		}
+		else
+		{
+			compute_range(kernel, first, first + band_size(band), out, smooth_out);
+		}
+	};
+
 #if defined(__unix__)
-			MPI_Send(&mpi_colours[0],	//Buffer 
-				mpincrement,				//Amount of data to send
-				MPI_INT,			 		//data type
-				0,							//Destination (master)
-				0,							//Tag (don't need one)
-				MPI_COMM_WORLD);
-
-			cout << "Send call from rank " << m_mpi_rank << endl;
+	const MPI_Datatype count_type = mpi_type_of<CountT>();
+	const size_t smooth_pixels = (NULL != smooth && 0 != rank) ? band_pixels : 0;
+	vector<int> recv_counts(mpi_size), displacements(mpi_size);
+	for (int r = 0; r < mpi_size; r++)
+	{
+		displacements[r] = (int)(r * band_pixels);
+	}
+
+	//Two rounds can be in flight at once, each with its own send buffers
+	vector<CountT> band_buffers[2] = { vector<CountT>(0 == rank ? 0 : band_pixels), vector<CountT>(0 == rank ? 0 : band_pixels) };
+	vector<float> smooth_buffers[2] = { vector<float>(smooth_pixels), vector<float>(smooth_pixels) };
+	MPI_Request gather_requests[4] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+
+	for (int round = 0; round < num_rounds; round++)
+	{
+		int current = round & 1;
+		int band = round * mpi_size + rank;
+		int my_count = (int)band_size(band);
+		size_t round_first = (size_t)round * mpi_size * band_pixels;
+
+		//The buffers we're about to overwrite belong to the gathers from two rounds ago
+		MPI_Waitall(2, &gather_requests[2 * current], MPI_STATUSES_IGNORE);
+
+		CountT *out = (0 == rank) ? &colours[0] + round_first : &band_buffers[current][0];
+		float *smooth_out = NULL;
+		if (NULL != smooth)
+		{
+			smooth_out = (0 == rank) ? smooth + round_first : &smooth_buffers[current][0];
+		}
+		if (0 < my_count)
+		{
+			compute_band(band, out, smooth_out);
+		}
+
+		for (int r = 0; r < mpi_size; r++)
+		{
+			recv_counts[r] = (int)band_size(round * mpi_size + r);
+		}
+
+#if MPI_VERSION >= 3
+		if (0 == rank)
+		{
+			MPI_Igatherv(MPI_IN_PLACE, my_count, count_type, &colours[0] + round_first, &recv_counts[0],
+						 &displacements[0], count_type, 0, MPI_COMM_WORLD, &gather_requests[2 * current]);
+			if (NULL != smooth)
+			{
+				MPI_Igatherv(MPI_IN_PLACE, my_count, MPI_FLOAT, smooth + round_first, &recv_counts[0],
+							 &displacements[0], MPI_FLOAT, 0, MPI_COMM_WORLD, &gather_requests[2 * current + 1]);
+			}
+		}
+		else
+		{
+			MPI_Igatherv(out, my_count, count_type, NULL, NULL, NULL, count_type, 0, MPI_COMM_WORLD,
+						 &gather_requests[2 * current]);
+			if (NULL != smooth)
+			{
+				MPI_Igatherv(smooth_out, my_count, MPI_FLOAT, NULL, NULL, NULL, MPI_FLOAT, 0, MPI_COMM_WORLD,
+							 &gather_requests[2 * current + 1]);
+			}
+		}
+
+		//Give the other round a chance to progress
+		int done = 0;
+		MPI_Testall(2, &gather_requests[2 * (current ^ 1)], &done, MPI_STATUSES_IGNORE);
+#else
+		if (0 == rank)
+		{
+			MPI_Gatherv(MPI_IN_PLACE, my_count, count_type, &colours[0] + round_first, &recv_counts[0],
+						&displacements[0], count_type, 0, MPI_COMM_WORLD);
+			if (NULL != smooth)
+			{
+				MPI_Gatherv(MPI_IN_PLACE, my_count, MPI_FLOAT, smooth + round_first, &recv_counts[0],
+							&displacements[0], MPI_FLOAT, 0, MPI_COMM_WORLD);
+			}
+		}
+		else
+		{
+			MPI_Gatherv(out, my_count, count_type, NULL, NULL, NULL, count_type, 0, MPI_COMM_WORLD);
+			if (NULL != smooth)
+			{
+				MPI_Gatherv(smooth_out, my_count, MPI_FLOAT, NULL, NULL, NULL, MPI_FLOAT, 0, MPI_COMM_WORLD);
+			}
+		}
+#endif
+	}
+
+	MPI_Waitall(4, gather_requests, MPI_STATUSES_IGNORE);
+#else
+	for (int band = 0; band < num_bands; band++)
+	{
+		size_t first = (size_t)band * band_pixels;
+		compute_band(band, &colours[first], smooth_at(smooth, first));
+	}
 #endif
+}
+
+// Master/worker MPI schedule. The image is cut into bands of m_mpi_band_rows rows,
+// rank 0 hands them out on demand and computes bands itself whenever it has no
+// results waiting. Each worker is kept MPI_BANDS_IN_FLIGHT bands ahead so it never
+// sits waiting for its next assignment, sends its results without blocking and
+// they are received straight into their place in colours. The smooth channel, if
+// any, follows each band's counts as a second message.
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_mpi_dynamic(const Kernel &kernel, std::vector<CountT> &colours, float *smooth,
+										 bool use_threads)
+{
+	const size_t band_pixels = (size_t)m_mpi_band_rows * m_screen_width;
+	const int num_bands = (m_screen_height + m_mpi_band_rows - 1) / m_mpi_band_rows;
+	double busy = 0.0;
+	double idle = 0.0;
+	int bands_done = 0;
+
+	//Pixels covered by a band, the last one may be short
+	auto band_size = [&](int band) -> size_t
+	{
+		size_t first = (size_t)band * band_pixels;
+		return (first + band_pixels < colours.size()) ? band_pixels : colours.size() - first;
+	};
+
+	auto compute_band = [&](int band, CountT *out, float *smooth_out)
+	{
+		double band_start = omp_get_wtime();
+		size_t first = (size_t)band * band_pixels;
+		if (use_threads)
+		{
+			compute_tiles(kernel, first, first + band_size(band), out, smooth_out);
 		}
-		else //Master, receive data and allocate to colours vector
+		else
 		{
+			compute_range(kernel, first, first + band_size(band), out, smooth_out);
+		}
+		busy += omp_get_wtime() - band_start;
+		bands_done++;
+	};
+
 #if defined(__unix__)
-			index = 0;
-			for (int b = buf_bounds_low; b < buf_bounds_high; b++)
+	const MPI_Datatype count_type = mpi_type_of<CountT>();
+
+	if (0 == m_mpi_rank)
+	{
+		int next_band = 0;
+		int outstanding = 0;
+
+		//Bands each worker has been given but not returned, in the order they were sent
+		vector<deque<int> > assigned(m_mpi_size);
+		vector<bool> stopped(m_mpi_size, false);
+
+		//Either the next band or -1 to say there are none left, exactly once per worker
+		auto assign = [&](int worker)
+		{
+			if (stopped[worker])
+			{
+				return;
+			}
+			int band = -1;
+			if (next_band < num_bands)
+			{
+				band = next_band++;
+				assigned[worker].push_back(band);
+				outstanding++;
+			}
+			else
+			{
+				stopped[worker] = true;
+			}
+			MPI_Send(&band, 1, MPI_INT, worker, MPI_TAG_BAND_ASSIGN, MPI_COMM_WORLD);
+		};
+
+		for (int ahead = 0; ahead < MPI_BANDS_IN_FLIGHT; ahead++)
+		{
+			for (int worker = 1; worker < m_mpi_size; worker++)
+			{
+				assign(worker);
+			}
+		}
+
+		while (0 < outstanding || next_band < num_bands)
+		{
+			int waiting = 0;
+			MPI_Status status;
+			MPI_Iprobe(MPI_ANY_SOURCE, MPI_TAG_BAND_RESULT, MPI_COMM_WORLD, &waiting, &status);
+
+			if (!waiting && next_band < num_bands)
+			{
+				//Nobody needs anything from us, so do some of the work ourselves
+				int band = next_band++;
+				size_t first = (size_t)band * band_pixels;
+				compute_band(band, &colours[first], smooth_at(smooth, first));
+				continue;
+			}
+
+			if (!waiting)
+			{
+				double wait_start = omp_get_wtime();
+				MPI_Probe(MPI_ANY_SOURCE, MPI_TAG_BAND_RESULT, MPI_COMM_WORLD, &status);
+				idle += omp_get_wtime() - wait_start;
+			}
+
+			//Messages from one rank arrive in order, so this is the oldest band we gave it
+			int worker = status.MPI_SOURCE;
+			int band = assigned[worker].front();
+			assigned[worker].pop_front();
+			outstanding--;
+
+			size_t first = (size_t)band * band_pixels;
+			MPI_Recv(&colours[first], (int)band_size(band), count_type,
+					 worker, MPI_TAG_BAND_RESULT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			if (NULL != smooth)
+			{
+				MPI_Recv(smooth + first, (int)band_size(band), MPI_FLOAT,
+						 worker, MPI_TAG_BAND_SMOOTH, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			}
+			assign(worker);
+		}
+
+		//Anyone who still had a spare band queued gets told to stop
+		for (int worker = 1; worker < m_mpi_size; worker++)
+		{
+			while (!stopped[worker])
+			{
+				assign(worker);
+			}
+		}
+	}
+	else
+	{
+		//Results go back with MPI_Isend, so while one buffer is in flight we compute into the other
+		const size_t smooth_pixels = (NULL != smooth) ? band_pixels : 0;
+		vector<CountT> band_buffers[2] = { vector<CountT>(band_pixels), vector<CountT>(band_pixels) };
+		vector<float> smooth_buffers[2] = { vector<float>(smooth_pixels), vector<float>(smooth_pixels) };
+		MPI_Request send_requests[4] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+		int current_buffer = 0;
+		deque<int> pending;
+		bool stop = false;
+
+		while (true)
+		{
+			//Pick up any assignments that have already arrived, block if we've run out
+			int ready = 0;
+			MPI_Iprobe(0, MPI_TAG_BAND_ASSIGN, MPI_COMM_WORLD, &ready, MPI_STATUS_IGNORE);
+			while ((ready || pending.empty()) && !stop)
+			{
+				int band;
+				double wait_start = omp_get_wtime();
+				MPI_Recv(&band, 1, MPI_INT, 0, MPI_TAG_BAND_ASSIGN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				idle += omp_get_wtime() - wait_start;
+
+				if (band < 0)
+				{
+					stop = true;
+				}
+				else
+				{
+					pending.push_back(band);
+				}
+				MPI_Iprobe(0, MPI_TAG_BAND_ASSIGN, MPI_COMM_WORLD, &ready, MPI_STATUS_IGNORE);
+			}
+
+			if (pending.empty())
+			{
+				break;
+			}
+
+			int band = pending.front();
+			pending.pop_front();
+
+			double wait_start = omp_get_wtime();
+			MPI_Waitall(2, &send_requests[2 * current_buffer], MPI_STATUSES_IGNORE);
+			idle += omp_get_wtime() - wait_start;
+
+			CountT *out = &band_buffers[current_buffer][0];
+			float *smooth_out = (NULL != smooth) ? &smooth_buffers[current_buffer][0] : NULL;
+			compute_band(band, out, smooth_out);
+			MPI_Isend(out, (int)band_size(band), count_type, 0, MPI_TAG_BAND_RESULT, MPI_COMM_WORLD,
+					  &send_requests[2 * current_buffer]);
+			if (NULL != smooth)
+			{
+				MPI_Isend(smooth_out, (int)band_size(band), MPI_FLOAT, 0, MPI_TAG_BAND_SMOOTH, MPI_COMM_WORLD,
+						  &send_requests[2 * current_buffer + 1]);
+			}
+			current_buffer ^= 1;
+		}
+
+		double wait_start = omp_get_wtime();
+		MPI_Waitall(4, send_requests, MPI_STATUSES_IGNORE);
+		idle += omp_get_wtime() - wait_start;
+	}
+
+	//Every rank reports its own balance to the master
+	double rank_times[3] = { busy * 1000.0, idle * 1000.0, (double)bands_done };
+	vector<double> all_times(0 == m_mpi_rank ? 3 * m_mpi_size : 0);
+	MPI_Gather(rank_times, 3, MPI_DOUBLE, 0 == m_mpi_rank ? &all_times[0] : NULL, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+	if (0 == m_mpi_rank && m_verbose)
+	{
+		for (int r = 0; r < m_mpi_size; r++)
+		{
+			cout << "Rank: " << r << " bands " << all_times[3 * r + 2] << ", compute " << all_times[3 * r]
+				 << " [ms], idle " << all_times[3 * r + 1] << " [ms]" << endl;
+		}
+	}
+#else
+	//No MPI, so we're the only rank and do every band
+	for (int band = 0; band < num_bands; band++)
+	{
+		size_t first = (size_t)band * band_pixels;
+		compute_band(band, &colours[first], smooth_at(smooth, first));
+	}
+#endif
+}
+
+// Mariani-Silver subdivision of the rectangle with inclusive corners (x0, y0) - (x1, y1),
+// in image coordinates, whose border has already been computed. If the whole border
+// has the same count the interior is filled with it, otherwise the rectangle is split
+// into four along a computed cross and each quarter is handled as its own task.
+// With smooth counts only a border at the cap is filled, escaped pixels on the same
+// integer count still differ in their fractional part so those interiors are computed.
+template <typename Kernel, typename CountT>
+void mandel_plotter::subdivide_rect(const Kernel &kernel, int x0, int y0, int x1, int y1, CountT *colours,
+									float *smooth, long long &computed, long long &filled)
+{
+	const int width = m_screen_width;
+	CountT border_value = colours[(size_t)y0 * width + x0];
+	bool uniform = true;
+
+	for (int x = x0; x <= x1 && uniform; ++x)
+	{
+		uniform = (colours[(size_t)y0 * width + x] == border_value) &&
+				  (colours[(size_t)y1 * width + x] == border_value);
+	}
+	for (int y = y0 + 1; y < y1 && uniform; ++y)
+	{
+		uniform = (colours[(size_t)y * width + x0] == border_value) &&
+				  (colours[(size_t)y * width + x1] == border_value);
+	}
+
+	int interior_w = x1 - x0 - 1;
+	int interior_h = y1 - y0 - 1;
+	if (interior_w <= 0 || interior_h <= 0)
+	{
+		return;
+	}
+
+	if (uniform && (NULL == smooth || (long long)border_value >= m_iter_max))
+	{
+		for (int y = y0 + 1; y < y1; ++y)
+		{
+			std::fill(colours + (size_t)y * width + x0 + 1, colours + (size_t)y * width + x1, border_value);
+		}
+		if (NULL != smooth)
+		{
+			//Pixels at the cap all have the cap as their smooth count
+			for (int y = y0 + 1; y < y1; ++y)
+			{
+				std::fill(smooth + (size_t)y * width + x0 + 1, smooth + (size_t)y * width + x1, (float)m_iter_max);
+			}
+		}
+#pragma omp atomic
+		filled += (long long)interior_w * interior_h;
+	}
+	else if (uniform || interior_w < SUBDIVIDE_MIN_SIZE || interior_h < SUBDIVIDE_MIN_SIZE)
+	{
+		//Not worth splitting any further (or a smooth escaped band that can't be filled),
+		//just compute what's left
+		for (int y = y0 + 1; y < y1; ++y)
+		{
+			size_t offset = (size_t)y * width + x0 + 1;
+			compute_span(kernel, y + m_screen_y_min, x0 + 1 + m_screen_x_min, x1 + m_screen_x_min,
+						 colours + offset, smooth_at(smooth, offset));
+		}
+#pragma omp atomic
+		computed += (long long)interior_w * interior_h;
+	}
+	else
+	{
+		int mx = (x0 + x1) / 2;
+		int my = (y0 + y1) / 2;
+
+		size_t row_offset = (size_t)my * width + x0 + 1;
+		size_t upper_offset = (size_t)(y0 + 1) * width + mx;
+		size_t lower_offset = (size_t)(my + 1) * width + mx;
+		compute_span(kernel, my + m_screen_y_min, x0 + 1 + m_screen_x_min, x1 + m_screen_x_min,
+					 colours + row_offset, smooth_at(smooth, row_offset));
+		compute_column(kernel, mx + m_screen_x_min, y0 + 1 + m_screen_y_min, my + m_screen_y_min,
+					   colours + upper_offset, smooth_at(smooth, upper_offset), width);
+		compute_column(kernel, mx + m_screen_x_min, my + 1 + m_screen_y_min, y1 + m_screen_y_min,
+					   colours + lower_offset, smooth_at(smooth, lower_offset), width);
+#pragma omp atomic
+		computed += interior_w + interior_h - 1;
+
+		bool spawn = (interior_w * interior_h >= SUBDIVIDE_TASK_AREA);
+#pragma omp task if(spawn) shared(computed, filled)
+		subdivide_rect(kernel, x0, y0, mx, my, colours, smooth, computed, filled);
+#pragma omp task if(spawn) shared(computed, filled)
+		subdivide_rect(kernel, mx, y0, x1, my, colours, smooth, computed, filled);
+#pragma omp task if(spawn) shared(computed, filled)
+		subdivide_rect(kernel, x0, my, mx, y1, colours, smooth, computed, filled);
+#pragma omp task if(spawn) shared(computed, filled)
+		subdivide_rect(kernel, mx, my, x1, y1, colours, smooth, computed, filled);
+#pragma omp taskwait
+	}
+}
+
+// Loop over each pixel from our image and check if the points associated with this pixel escape to infinity
+template <typename Kernel, typename CountT>
+void mandel_plotter::get_number_iterations(std::vector<CountT> &colours, parallelisation_type parallel_type,
+										   const Kernel &kernel, float *smooth)
+{
+	int colour_index = 0;
+	if (NO_PARALLEL == parallel_type)
+	{
+		if (m_verbose)
+		{
+			cout << "Using sequential Mandelbrot" << endl;
+		}
+		for (int i = m_screen_y_min; i < m_screen_y_max; ++i) 
+		{
+			//returns the number of iterations for each pixel of the row
+			//and assigns it to the appropriate colours index
+			compute_span(kernel, i, m_screen_x_min, m_screen_x_max, &colours[colour_index], smooth_at(smooth, colour_index));
+			colour_index += m_screen_width;
+
+			/* May Reenable this given particular fractal parameters
+			if (progress < (int)(i*100.0 / m_screen.get_y_max())) {
+			progress = (int)(i*100.0 / m_screen.get_y_max());
+			std::cout << progress << "%\n";
+			}
+			*/
+		}
+	}
+	else if( OMP_PARALLEL == parallel_type)
+	{
+		if (m_verbose)
+		{
+			cout << "Using OpenMP parallelised Mandelbrot" << endl;
+		}
+		//Tiles are balanced between threads by the work-stealing scheduler
+		compute_tiles(kernel, 0, colours.size(), &colours[0], smooth);
+	}
+	else if ((MPI_PARALLEL == parallel_type || BOTH_PARALLEL == parallel_type) &&
+			 MPI_SCHEDULE_DYNAMIC == m_mpi_schedule)
+	{
+		if (m_verbose)
+		{
+			cout << "Rank: " << m_mpi_rank << " Using dynamically scheduled "
+				 << ((BOTH_PARALLEL == parallel_type) ? "OpenMP & MPI" : "MPI only") << " Mandelbrot" << endl;
+		}
+		compute_mpi_dynamic(kernel, colours, smooth, BOTH_PARALLEL == parallel_type);
+	}
+	else if (MPI_PARALLEL == parallel_type || BOTH_PARALLEL == parallel_type)
+	{
+		if (m_verbose)
+		{
+			cout << "Rank: " << m_mpi_rank << " Using statically scheduled "
+				 << ((BOTH_PARALLEL == parallel_type) ? "OpenMP & MPI" : "MPI only") << " Mandelbrot" << endl;
+		}
+		compute_mpi_static(kernel, colours, smooth, BOTH_PARALLEL == parallel_type);
+	}
+	else if (SUBDIVIDE_PARALLEL == parallel_type)
+	{
+		if (m_verbose)
+		{
+			cout << "Using Mariani-Silver subdivision Mandelbrot (OpenMP tasks)" << endl;
+		}
+		long long computed = 0;
+		long long filled = 0;
+
+		//Grid lines every SUBDIVIDE_TILE_SIZE pixels, plus the last row/column so
+		//every tile has all four edges
+		vector<int> grid_x, grid_y;
+		for (int x = 0; x < m_screen_width - 1; x += SUBDIVIDE_TILE_SIZE)
+		{
+			grid_x.push_back(x);
+		}
+		grid_x.push_back(m_screen_width - 1);
+		for (int y = 0; y < m_screen_height - 1; y += SUBDIVIDE_TILE_SIZE)
+		{
+			grid_y.push_back(y);
+		}
+		grid_y.push_back(m_screen_height - 1);
+
+		//Compute every grid line up front, the tile borders then all exist
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:computed) num_threads(m_scheduler.get_num_threads())
+		for (int g = 0; g < (int)grid_y.size(); ++g)
+		{
+			size_t offset = (size_t)grid_y[g] * m_screen_width;
+			compute_span(kernel, grid_y[g] + m_screen_y_min, m_screen_x_min, m_screen_x_max, &colours[offset],
+						 smooth_at(smooth, offset));
+			computed += m_screen_width;
+		}
+
+		//Columns only need the pixels between the grid rows
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:computed) num_threads(m_scheduler.get_num_threads())
+		for (int g = 0; g < (int)(grid_x.size() * (grid_y.size() - 1)); ++g)
+		{
+			int x = grid_x[g % grid_x.size()];
+			int y0 = grid_y[g / grid_x.size()] + 1;
+			int y1 = grid_y[g / grid_x.size() + 1];
+			size_t offset = (size_t)y0 * m_screen_width + x;
+			compute_column(kernel, x + m_screen_x_min, y0 + m_screen_y_min, y1 + m_screen_y_min,
+						   &colours[offset], smooth_at(smooth, offset), m_screen_width);
+			computed += y1 - y0;
+		}
+
+#pragma omp parallel num_threads(m_scheduler.get_num_threads())
+		{
+#pragma omp single
 			{
-				colours[b] = mpi_colours[index];
-				index++;
+				for (size_t ty = 0; ty + 1 < grid_y.size(); ++ty)
+				{
+					for (size_t tx = 0; tx + 1 < grid_x.size(); ++tx)
+					{
+						int x0 = grid_x[tx], x1 = grid_x[tx + 1];
+						int y0 = grid_y[ty], y1 = grid_y[ty + 1];
+#pragma omp task firstprivate(x0, x1, y0, y1) shared(colours, computed, filled)
+						subdivide_rect(kernel, x0, y0, x1, y1, &colours[0], smooth, computed, filled);
+					}
+				}
 			}
+		}
+
+		if (m_verbose)
+		{
+			cout << "Subdivision computed " << computed << " pixels and filled " << filled << " of "
+				 << colours.size() << " (" << (100.0 * computed / colours.size()) << "% computed)" << endl;
+		}
+	}
+}
+
+// Fused render for NO_PARALLEL / OMP_PARALLEL. Each tile is computed into a buffer
+// of its own and handed to tile_done straight away, while it is still in cache,
+// and only copied into colours / smooth if the caller wants to keep them.
+template <typename Kernel, typename CountT>
+void mandel_plotter::compute_fused(const Kernel &kernel, parallelisation_type parallel_type,
+								   const tile_callback<CountT> &tile_done, std::vector<CountT> *colours,
+								   std::vector<float> *smooth)
+{
+	vector<tile> tiles;
+	tile_scheduler::make_tiles(0, (size_t)m_screen_width * m_screen_height, m_screen_width, m_tile_size, tiles);
+
+	const int num_buffers = (OMP_PARALLEL == parallel_type) ? m_scheduler.get_num_threads() : 1;
+	const size_t tile_pixels = (size_t)m_tile_size * m_tile_size;
+	vector<vector<CountT> > count_buffers(num_buffers, vector<CountT>(tile_pixels));
+	vector<vector<float> > smooth_buffers(num_buffers, vector<float>((NULL != smooth) ? tile_pixels : 0));
+
+	auto do_tile = [&](const tile &t)
+	{
+		int thread = (OMP_PARALLEL == parallel_type) ? omp_get_thread_num() : 0;
+		int tile_width = t.x_end - t.x_begin;
+		CountT *counts = &count_buffers[thread][0];
+		float *tile_smooth = (NULL != smooth) ? &smooth_buffers[thread][0] : NULL;
+
+		for (int y = t.y_begin; y < t.y_end; ++y)
+		{
+			size_t offset = (size_t)(y - t.y_begin) * tile_width;
+			compute_span(kernel, y + m_screen_y_min, t.x_begin + m_screen_x_min, t.x_end + m_screen_x_min,
+						 counts + offset, smooth_at(tile_smooth, offset));
+		}
+
+		//Only rank 0 has an image to colour into
+		if (0 >= m_mpi_rank)
+		{
+			tile_done(t, counts, tile_smooth);
+		}
+
+		for (int y = t.y_begin; y < t.y_end; ++y)
+		{
+			size_t offset = (size_t)(y - t.y_begin) * tile_width;
+			size_t image_offset = (size_t)y * m_screen_width + t.x_begin;
+			if (NULL != colours)
+			{
+				std::copy(counts + offset, counts + offset + tile_width, &(*colours)[image_offset]);
+			}
+			if (NULL != smooth)
+			{
+				std::copy(tile_smooth + offset, tile_smooth + offset + tile_width, &(*smooth)[image_offset]);
+			}
+		}
+	};
+
+	if (OMP_PARALLEL == parallel_type)
+	{
+		m_scheduler.run(tiles, do_tile);
+	}
+	else
+	{
+		for (size_t t = 0; t < tiles.size(); ++t)
+		{
+			do_tile(tiles[t]);
+		}
+	}
+}
+
+void mandel_plotter::get_centre(int num_limbs, fixed_point &real, fixed_point &imaginary)
+{
+	if (m_centre_real.empty())
+	{
+		real = fixed_point::from_double(m_fractal_min_real + m_reference_x * m_real_factor, num_limbs);
+		imaginary = fixed_point::from_double(m_fractal_max_imaginary - m_reference_y * m_imaginary_factor, num_limbs);
+	}
+	else
+	{
+		fixed_point::from_string(m_centre_real, num_limbs, real);
+		fixed_point::from_string(m_centre_imaginary, num_limbs, imaginary);
+	}
+}
+
+void mandel_plotter::prepare_scalar_type(void)
+{
+	double step = std::min(fabs(m_real_factor), fabs(m_imaginary_factor));
+	scalar_type type = m_scalar_type;
+	if (SCALAR_AUTO == type)
+	{
+		double magnitude = std::max(std::max(fabs(m_fractal_min_real), fabs(m_fractal_max_real)),
+									std::max(fabs(m_fractal_min_imaginary), fabs(m_fractal_max_imaginary)));
+		type = select_scalar_type(step, magnitude);
+	}
+	if (0 == scalar_type_digits(type))
+	{
+		cout << "Error: " << scalar_type_name(type) << " isn't available with this compiler, using double-double" << endl;
+		type = SCALAR_DOUBLE_DOUBLE;
+	}
+	if (SCALAR_FLOAT == type && FIRST_ORDER != m_formula && THIRD_ORDER != m_formula)
+	{
+		//Only the kernels with SIMD loops have a float version, not worth a message for auto
+		if (SCALAR_AUTO != m_scalar_type)
+		{
+			cout << "Error: float is only available for the first and third order formulas, using double" << endl;
+		}
+		type = SCALAR_DOUBLE;
+	}
+	if (SCALAR_DOUBLE != type && SCALAR_FLOAT != type && FIRST_ORDER != m_formula)
+	{
+		cout << "Error: extended precision only supports the first order formula, using double" << endl;
+		type = SCALAR_DOUBLE;
+	}
+
+	m_active_scalar = type;
+	if (SCALAR_DOUBLE != m_active_scalar && SCALAR_FLOAT != m_active_scalar)
+	{
+		int limbs = fixed_point::limbs_for_resolution(step);
+		m_extended_real = fixed_point(limbs);
+		m_extended_imaginary = fixed_point(limbs);
+		get_centre(limbs, m_extended_real, m_extended_imaginary);
+	}
+	if (SCALAR_DOUBLE != m_active_scalar)
+	{
+		cout << "Scalar type: " << scalar_type_name(m_active_scalar) << endl;
+	}
+}
 
-			for (int t = 1; t < mpi_comm_size; t++)
-			{
-				MPI_Status status;
-				size_t rcv_rank;
+// Works out how many limbs the pixel spacing needs and iterates the centre in fixed point
+bool mandel_plotter::prepare_perturbation(void)
+{
+	if (FIRST_ORDER != m_formula)
+	{
+		cout << "Error: perturbation only supports the first order formula, iterating directly" << endl;
+		return false;
+	}
+
+	double step = std::min(fabs(m_real_factor), fabs(m_imaginary_factor));
+	int limbs = fixed_point::limbs_for_resolution(step);
+	fixed_point real(limbs);
+	fixed_point imaginary(limbs);
+	get_centre(limbs, real, imaginary);
 
-				MPI_Recv(&mpi_colours[0],		//buffer
-					mpincrement,				//Amount of data to recv
-					MPI_INT,					//Data type
-					MPI_ANY_SOURCE,				//source
-					0,							//Tag
-					MPI_COMM_WORLD,				//Comm
-					&status);					//status
+	double start = omp_get_wtime();
+	m_reference.compute(real, imaginary, m_iter_max);
+	if (m_series_approximation)
+	{
+		//Offset of the furthest corner from the reference pixel
+		double radius = hypot(m_reference_x - m_screen_x_min, m_reference_y - m_screen_y_min) *
+						std::max(fabs(m_real_factor), fabs(m_imaginary_factor));
+		m_reference.compute_series(radius);
+	}
+	double end = omp_get_wtime();
 
-				rcv_rank = status.MPI_SOURCE;
-				cout << "Master Receive call from rank " << rcv_rank << endl;
+	cout << "Rank: " << m_mpi_rank << " reference orbit of " << m_reference.length() - 1 << " iterations at "
+		 << 32 * (limbs - 1) << " bits took " << (end - start) * 1000.0 << " [ms]" << endl;
+	if (m_series_approximation)
+	{
+		cout << "Rank: " << m_mpi_rank << " series approximation usable for up to "
+			 << m_reference.series_length() - 1 << " iterations" << endl;
+	}
+	return true;
+}
 
-				//Get boundaries for sender 
-				size_t rcvbuf_bounds_low = rcv_rank * mpincrement;
-				size_t rcvbuf_bounds_high = ((rcv_rank + 1) * mpincrement) - 1;
+// Recomputes an even spread of the pixels in double and counts how many came out
+// differently in float
+template <typename CountT>
+void mandel_plotter::validate_float(const std::vector<CountT> &colours)
+{
+	size_t total = colours.size();
+	size_t samples = ((size_t)m_float_validation_samples < total) ? (size_t)m_float_validation_samples : total;
 
-				int index = 0;
-				//Now copy this to the main colours vector
-				for (int b = rcvbuf_bounds_low; b < rcvbuf_bounds_high; b++)
-				{
-					colours[b] = mpi_colours[index];
-					index++;
-				}
-			}
-#endif
+	m_float_validation.sampled = (long long)samples;
+	m_float_validation.mismatched = 0;
+	m_float_validation.max_difference = 0;
+	for (size_t s = 0; s < samples; ++s)
+	{
+		size_t pixel = (2 * s + 1) * total / (2 * samples);
+		unsigned int x = (unsigned int)(pixel % m_screen_width + m_screen_x_min);
+		unsigned int y = (unsigned int)(pixel / m_screen_width + m_screen_y_min);
+		int difference = abs(check_value_within_set(pixel_to_complex(x, y)) - (int)colours[pixel]);
+		if (0 != difference)
+		{
+			m_float_validation.mismatched++;
+			m_float_validation.max_difference = std::max(m_float_validation.max_difference, difference);
 		}
 	}
+
+	cout << "Float validation: " << m_float_validation.mismatched << " of " << m_float_validation.sampled
+		 << " sampled pixels differ from double (" << (100.0 * m_float_validation.mismatched / samples)
+		 << "%), largest difference " << m_float_validation.max_difference << " iterations" << endl;
 }
 
-//Can definitely expand the performance testing & analysis in here once working as intended.
-void mandel_plotter::fractal(std::vector<int> &colours, parallelisation_type parallel_type) 
+// Checks the count type can hold m_iter_max and clears the stats of the last render
+template <typename CountT>
+bool mandel_plotter::begin_render(void)
 {
-	//May re-enable the progress bar for larger fractal computations
-	cout << "Computing Mandelbrot Fractals please wait..." << endl;
+	if ((unsigned long long)m_iter_max > (unsigned long long)numeric_limits<CountT>::max())
+	{
+		cout << "Error: max iterations " << m_iter_max << " don't fit in the " << 8 * sizeof(CountT)
+			 << " bit count buffer" << endl;
+		return false;
+	}
+
+	cout << "Vector unit: " << simd_level_name(m_simd_level) << endl;
+	m_interior_stats.cardioid = 0;
+	m_interior_stats.periodic = 0;
+	m_scheduler.reset_stats();
+
+	m_perturbation_stats.references = 0;
+	m_perturbation_stats.glitched = 0;
+	m_perturbation_stats.unresolved = 0;
+	m_perturbation_stats.skipped = 0;
+	m_perturbation_active = m_perturbation && prepare_perturbation();
+	if (m_perturbation_active)
+	{
+		m_perturbation_stats.references = 1;
+	}
+
+	//Perturbation does its own thing with the precision
+	m_active_scalar = SCALAR_DOUBLE;
+	if (!m_perturbation_active)
+	{
+		prepare_scalar_type();
+	}
+	return true;
+}
+
+// The escaped samples' counts are sorted and the cap put just past the target
+// quantile. Samples still at the ceiling are either interior (what the checks
+// caught) or too deep for it, they are reported but can't move the estimate.
+int mandel_plotter::estimate_iter_max(double target_fraction, int ceiling)
+{
+	if (!(target_fraction > 0.0 && target_fraction <= 1.0) || ceiling < AUTO_ITER_MIN)
+	{
+		cout << "Error: can't estimate max iterations for fraction " << target_fraction << " and ceiling "
+			 << ceiling << ", keeping " << m_iter_max << endl;
+		return m_iter_max;
+	}
+
+	const int iter_max = m_iter_max;
+	const int interior_checks = m_interior_checks;
+	const int samples_x = std::max(2, std::min(AUTO_ITER_SAMPLES, m_screen_width));
+	const int samples_y = std::max(2, std::min(m_screen_height, samples_x * m_screen_height / m_screen_width));
+
+	//Both checks, so interior samples stop long before the ceiling
+	m_iter_max = ceiling;
+	m_interior_checks = INTERIOR_CARDIOID | INTERIOR_PERIODICITY;
+	bool verbose = m_verbose;
+	m_verbose = false;
+
 	double start = omp_get_wtime();
-	get_number_iterations(colours, parallel_type);
+	vector<int> counts;
+	if (begin_render<int>())
+	{
+		switch (m_formula)
+		{
+		case FIRST_ORDER:
+			sample_grid(first_order_kernel(), samples_x, samples_y, counts);
+			break;
+		case THIRD_ORDER:
+			sample_grid(third_order_kernel(), samples_x, samples_y, counts);
+			break;
+		case MULTIBROT:
+			sample_grid(multibrot_kernel(m_formula_order), samples_x, samples_y, counts);
+			break;
+		default:
+			sample_grid(custom_kernel(m_mandel_func), samples_x, samples_y, counts);
+			break;
+		}
+	}
 	double end = omp_get_wtime();
 
+	long long interior = m_interior_stats.cardioid + m_interior_stats.periodic;
+	m_iter_max = iter_max;
+	m_interior_checks = interior_checks;
+	m_verbose = verbose;
+
+	vector<int> escaped;
+	for (size_t n = 0; n < counts.size(); ++n)
+	{
+		if (counts[n] < ceiling)
+		{
+			escaped.push_back(counts[n]);
+		}
+	}
+	long long unresolved = (long long)(counts.size() - escaped.size()) - interior;
+
+	int estimate = AUTO_ITER_MIN;
+	if (!escaped.empty())
+	{
+		sort(escaped.begin(), escaped.end());
+		size_t index = (size_t)ceil(target_fraction * escaped.size());
+		index = (index > 0) ? index - 1 : 0;
+		estimate = std::max(AUTO_ITER_MIN, std::min(ceiling, escaped[index] + 1));
+	}
+
+	if (0 >= m_mpi_rank)
+	{
+		cout << "Estimated max iterations: " << estimate << " from " << counts.size() << " samples ("
+			 << escaped.size() << " escaped, " << interior << " interior, " << unresolved
+			 << " still going at " << ceiling << ") in " << (end - start) << " [s]" << endl;
+	}
+	return estimate;
+}
+
+// Per rank balance and shortcut stats, then the total time on rank 0
+void mandel_plotter::report_render(parallelisation_type parallel_type, double start, double end)
+{
+	if (OMP_PARALLEL == parallel_type || BOTH_PARALLEL == parallel_type)
+	{
+		m_scheduler.report(m_mpi_rank);
+	}
+
+	if (INTERIOR_NONE != m_interior_checks)
+	{
+		//These are per rank when the work is split with MPI
+		cout << "Rank: " << m_mpi_rank << " interior pixels skipped by cardioid/bulb test: " << m_interior_stats.cardioid
+			 << ", by periodicity check: " << m_interior_stats.periodic << endl;
+	}
+
+	if (m_perturbation_active)
+	{
+		cout << "Rank: " << m_mpi_rank << " perturbation references: " << m_perturbation_stats.references
+			 << ", glitched pixels: " << m_perturbation_stats.glitched
+			 << ", unresolved: " << m_perturbation_stats.unresolved
+			 << ", iterations skipped by series: " << m_perturbation_stats.skipped << endl;
+	}
+
 	/*Now we add some basic details to the logfile 
 	switch(parallel_type)
 	{
@@ -378,47 +2263,543 @@ void mandel_plotter::fractal(std::vector<int> &colours, parallelisation_type par
 
 	m_logger->add_logfile_detail("Image Dimensions: [" + to_string(m_screen_width) + "," + to_string(m_screen_height) + ']');
 	*/
-	double temp_duration;
-	double total_duration;
+	double duration = std::chrono::duration <double, std::milli>(end - start).count();
+	double total_duration = duration;
 #if defined(__unix__)
-	MPI_Status status;
+	//Sum of every rank's time, collected in one go rather than a receive per rank
+	MPI_Reduce(&duration, &total_duration, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+#endif
+
+	if (0 >= m_mpi_rank)
+	{
+		m_logger->add_logfile_detail(to_string(total_duration) + ' ');
+		m_logger->write_logdetails_to_path();
+		std::cout << "Total time to generate fractals: " << total_duration << " [s]" << std::endl;
+	}
+}
+
+//Can definitely expand the performance testing & analysis in here once working as intended.
+template <typename CountT>
+void mandel_plotter::fractal(std::vector<CountT> &colours, parallelisation_type parallel_type, std::vector<float> *smooth)
+{
+	//May re-enable the progress bar for larger fractal computations
+	cout << "Computing Mandelbrot Fractals please wait..." << endl;
+	if (!begin_render<CountT>())
+	{
+		return;
+	}
+
+	//Only the double loops on a single rank can keep their orbits
+	m_saved_orbits.iter_max = 0;
+	m_saved_orbits.pixels.clear();
+	m_saved_orbits.z.clear();
+	m_orbits_active = m_orbit_saving && !m_perturbation_active && SCALAR_DOUBLE == m_active_scalar &&
+					  (NO_PARALLEL == parallel_type || OMP_PARALLEL == parallel_type);
+
+	double start = omp_get_wtime();
+	get_number_iterations(colours, parallel_type, smooth);
+	double end = omp_get_wtime();
 
-		if (0 != m_mpi_rank) //Send temp values to master
+	if (m_orbits_active)
+	{
+		m_orbits_active = false;
+		m_saved_orbits.iter_max = m_iter_max;
+		m_saved_orbits.key = get_cache_key(NO_PARALLEL);
+		if (m_verbose)
 		{
-			temp_duration = std::chrono::duration <double, std::milli>(end - start).count();
-			
-			MPI_Send(&temp_duration,		//Buffer 
-				1,				//Amount of data to send
-				MPI_DOUBLE,			 		//data type
-				0,							//Destination (master)
-				1,							//Tag (don't need one)
-				MPI_COMM_WORLD);			
+			cout << "Kept the orbits of " << m_saved_orbits.pixels.size() << " pixels left at the cap" << endl;
 		}
-		else
-		{
-			temp_duration = std::chrono::duration <double, std::milli>(end - start).count();
-			total_duration += temp_duration;
+	}
+
+	report_render(parallel_type, start, end);
+
+	//Only rank 0 has all of the counts
+	if (SCALAR_FLOAT == m_active_scalar && 0 < m_float_validation_samples && 0 >= m_mpi_rank)
+	{
+		validate_float(colours);
+	}
+}
+
+template <typename CountT>
+void mandel_plotter::extend_iterations(std::vector<CountT> &colours, parallelisation_type parallel_type, int iter_max,
+									   std::vector<float> *smooth)
+{
+	//The key has the cap in it, so it has to be checked before the cap changes
+	bool resumable = 0 < m_saved_orbits.iter_max && m_saved_orbits.iter_max == m_iter_max && iter_max > m_iter_max &&
+					 !m_saved_orbits.key.empty() && m_saved_orbits.key == get_cache_key(NO_PARALLEL) &&
+					 colours.size() == (size_t)m_screen_width * m_screen_height &&
+					 (NULL == smooth || smooth->size() == colours.size());
+	int previous_iter_max = m_iter_max;
+	m_iter_max = iter_max;
+
+	if (!resumable)
+	{
+		cout << "No saved orbits for this view, rendering it again at " << m_iter_max << " iterations" << endl;
+		fractal(colours, parallel_type, smooth);
+		return;
+	}
+
+	cout << "Extending Mandelbrot Fractals from " << previous_iter_max << " iterations please wait..." << endl;
+	if (!begin_render<CountT>())
+	{
+		m_iter_max = previous_iter_max;
+		return;
+	}
+
+	double start = omp_get_wtime();
 
-			for (int t = 1; t < m_mpi_size; t++)
+	//Pixels an interior check settled aren't saved but are still at the old cap,
+	//the saved ones are all overwritten below
+	for (size_t pixel = 0; pixel < colours.size(); ++pixel)
+	{
+		if ((int)colours[pixel] == previous_iter_max)
+		{
+			colours[pixel] = (CountT)m_iter_max;
+			if (NULL != smooth)
 			{
-				MPI_Recv(&temp_duration,		//buffer
-					1,				//Amount of data to recv
-					MPI_DOUBLE,					//Data type
-					MPI_ANY_SOURCE,				//source
-					1,							//Tag
-					MPI_COMM_WORLD,				//Comm
-					&status);					//status
+				(*smooth)[pixel] = (float)m_iter_max;
+			}
+		}
+	}
+
+	switch (m_formula)
+	{
+	case FIRST_ORDER:
+		extend_orbits(first_order_kernel(), colours, smooth, parallel_type, previous_iter_max);
+		break;
+	case THIRD_ORDER:
+		extend_orbits(third_order_kernel(), colours, smooth, parallel_type, previous_iter_max);
+		break;
+	case MULTIBROT:
+		extend_orbits(multibrot_kernel(m_formula_order), colours, smooth, parallel_type, previous_iter_max);
+		break;
+	default:
+		extend_orbits(custom_kernel(m_mandel_func), colours, smooth, parallel_type, previous_iter_max);
+		break;
+	}
+	double end = omp_get_wtime();
+
+	m_saved_orbits.iter_max = m_iter_max;
+	m_saved_orbits.key = get_cache_key(NO_PARALLEL);
+	report_render(parallel_type, start, end);
+}
+
+// Works out where the pixels of the previous frame are in this one, one axis at a
+// time, then copies the ones that line up and computes the rest
+template <typename CountT>
+void mandel_plotter::fractal_reuse(std::vector<CountT> &colours, parallelisation_type parallel_type,
+								   window<double> previous_fractal, const std::vector<CountT> &previous,
+								   std::vector<float> *smooth, const std::vector<float> *previous_smooth)
+{
+	size_t num_pixels = (size_t)m_screen_width * m_screen_height;
+	if (m_perturbation || (NO_PARALLEL != parallel_type && OMP_PARALLEL != parallel_type) ||
+		previous.size() != num_pixels ||
+		(NULL != smooth && (NULL == previous_smooth || previous_smooth->size() != num_pixels)))
+	{
+		fractal(colours, parallel_type, smooth);
+		return;
+	}
+
+	cout << "Computing Mandelbrot Fractals from the previous frame please wait..." << endl;
+	if (!begin_render<CountT>())
+	{
+		return;
+	}
+
+	//The counts no longer match any orbits kept by the last render
+	m_saved_orbits.iter_max = 0;
+	m_saved_orbits.pixels.clear();
+	m_saved_orbits.z.clear();
+
+	colours.resize(num_pixels);
+	float *smooth_out = NULL;
+	if (NULL != smooth)
+	{
+		smooth->resize(num_pixels);
+		smooth_out = &(*smooth)[0];
+	}
+
+	//The previous view the same way set_window takes it
+	double previous_min_real = previous_fractal.get_x_min();
+	double previous_min_imaginary = previous_fractal.get_y_min();
+	double previous_width = previous_fractal.get_x_max() - previous_min_real;
+	double previous_max_imaginary = previous_min_imaginary + previous_width * m_screen_height / m_screen_width;
+	double previous_real_factor = previous_width / (m_screen_width - 1);
+	double previous_imaginary_factor = (previous_max_imaginary - previous_min_imaginary) / (m_screen_height - 1);
+
+	//Rows count down from the maximum imaginary part
+	vector<int> match_x = match_axis(m_screen_width,
+		(m_fractal_min_real - previous_min_real + m_screen_x_min * m_real_factor) / previous_real_factor - m_screen_x_min,
+		m_real_factor / previous_real_factor, m_screen_width);
+	vector<int> match_y = match_axis(m_screen_height,
+		(previous_max_imaginary - m_fractal_max_imaginary + m_screen_y_min * m_imaginary_factor) / previous_imaginary_factor -
+		m_screen_y_min, m_imaginary_factor / previous_imaginary_factor, m_screen_height);
+
+	long long reused = 0;
+	double start = omp_get_wtime();
+	switch (m_formula)
+	{
+	case FIRST_ORDER:
+		reused = reuse_rows(first_order_kernel(), parallel_type, colours, smooth_out, previous,
+							(NULL != smooth) ? &(*previous_smooth)[0] : NULL, match_x, match_y);
+		break;
+	case THIRD_ORDER:
+		reused = reuse_rows(third_order_kernel(), parallel_type, colours, smooth_out, previous,
+							(NULL != smooth) ? &(*previous_smooth)[0] : NULL, match_x, match_y);
+		break;
+	case MULTIBROT:
+		reused = reuse_rows(multibrot_kernel(m_formula_order), parallel_type, colours, smooth_out, previous,
+							(NULL != smooth) ? &(*previous_smooth)[0] : NULL, match_x, match_y);
+		break;
+	default:
+		reused = reuse_rows(custom_kernel(m_mandel_func), parallel_type, colours, smooth_out, previous,
+							(NULL != smooth) ? &(*previous_smooth)[0] : NULL, match_x, match_y);
+		break;
+	}
+	double end = omp_get_wtime();
+
+	if (m_verbose)
+	{
+		cout << "Reused " << reused << " of " << num_pixels << " pixels from the previous frame ("
+			 << (100.0 * reused / num_pixels) << "%)" << endl;
+	}
+	report_render(parallel_type, start, end);
+}
+
+// The pass at every 4th pixel is 1/16 of the work, so the first frame is out long
+// before the full one. The compute time reported leaves out the callbacks.
+template <typename CountT>
+void mandel_plotter::fractal_progressive(std::vector<CountT> &colours, parallelisation_type parallel_type,
+										 const pass_callback<CountT> &pass_done, std::vector<float> *smooth)
+{
+	if (NO_PARALLEL != parallel_type && OMP_PARALLEL != parallel_type)
+	{
+		fractal(colours, parallel_type, smooth);
+		if (0 >= m_mpi_rank)
+		{
+			pass_done(1, colours, smooth);
+		}
+		return;
+	}
+
+	cout << "Computing Mandelbrot Fractals progressively please wait..." << endl;
+	if (!begin_render<CountT>())
+	{
+		return;
+	}
+
+	m_saved_orbits.iter_max = 0;
+	m_saved_orbits.pixels.clear();
+	m_saved_orbits.z.clear();
+
+	colours.resize((size_t)m_screen_width * m_screen_height);
+	float *smooth_out = NULL;
+	if (NULL != smooth)
+	{
+		smooth->resize(colours.size());
+		smooth_out = &(*smooth)[0];
+	}
+
+	double start = omp_get_wtime();
+	double compute_time = 0.0;
+	for (int step = PROGRESSIVE_FIRST_STEP; step >= 1; step /= 2)
+	{
+		bool first_pass = (PROGRESSIVE_FIRST_STEP == step);
+		double pass_start = omp_get_wtime();
+		switch (m_formula)
+		{
+		case FIRST_ORDER:
+			progressive_pass(first_order_kernel(), parallel_type, step, first_pass, colours, smooth_out);
+			break;
+		case THIRD_ORDER:
+			progressive_pass(third_order_kernel(), parallel_type, step, first_pass, colours, smooth_out);
+			break;
+		case MULTIBROT:
+			progressive_pass(multibrot_kernel(m_formula_order), parallel_type, step, first_pass, colours, smooth_out);
+			break;
+		default:
+			progressive_pass(custom_kernel(m_mandel_func), parallel_type, step, first_pass, colours, smooth_out);
+			break;
+		}
+		compute_time += omp_get_wtime() - pass_start;
+
+		if (m_verbose)
+		{
+			cout << "Pass at every " << step << " pixels ready after " << (omp_get_wtime() - start) << " [s]" << endl;
+		}
+		pass_done(step, colours, smooth);
+	}
+
+	report_render(parallel_type, 0.0, compute_time);
+}
+
+// Stratified jitter, one random point in each cell of a grid x grid split of the
+// pixel. Every picked pixel uses the same points, which is what lets them all go
+// through the span loops together.
+template <typename CountT>
+long long mandel_plotter::antialias(const std::vector<CountT> &colours, parallelisation_type parallel_type,
+									antialias_samples &samples, const std::vector<float> *smooth, int grid,
+									double threshold)
+{
+	const size_t num_pixels = (size_t)m_screen_width * m_screen_height;
+	samples.per_pixel = 0;
+	samples.pixels.clear();
+	samples.counts.clear();
+	samples.smooth.clear();
+	if (grid < 2 || colours.size() != num_pixels || (NULL != smooth && smooth->size() != num_pixels))
+	{
+		cout << "Error: can't antialias " << colours.size() << " counts with a grid of " << grid << endl;
+		return 0;
+	}
 
-				total_duration += temp_duration;
+	cout << "Antialiasing Mandelbrot Fractals please wait..." << endl;
+	if (!begin_render<uint32_t>())
+	{
+		return 0;
+	}
+	const bool use_threads = (NO_PARALLEL != parallel_type && MPI_PARALLEL != parallel_type);
+	double start = omp_get_wtime();
+
+	//Edge pixels, compared with all 8 neighbours
+	const double limit = std::max(1.0, threshold * m_iter_max);
+	vector<char> edge(num_pixels, 0);
+#pragma omp parallel for schedule(static) num_threads(m_scheduler.get_num_threads()) if (use_threads)
+	for (int y = 0; y < m_screen_height; ++y)
+	{
+		for (int x = 0; x < m_screen_width; ++x)
+		{
+			size_t pixel = (size_t)y * m_screen_width + x;
+			double value = (NULL != smooth) ? (*smooth)[pixel] : (double)colours[pixel];
+			for (int ny = std::max(0, y - 1); ny <= std::min(m_screen_height - 1, y + 1) && !edge[pixel]; ++ny)
+			{
+				for (int nx = std::max(0, x - 1); nx <= std::min(m_screen_width - 1, x + 1); ++nx)
+				{
+					size_t neighbour = (size_t)ny * m_screen_width + nx;
+					double other = (NULL != smooth) ? (*smooth)[neighbour] : (double)colours[neighbour];
+					if (fabs(value - other) > limit)
+					{
+						edge[pixel] = 1;
+						break;
+					}
+				}
 			}
+		}
+	}
+	for (size_t pixel = 0; pixel < num_pixels; ++pixel)
+	{
+		if (edge[pixel])
+		{
+			samples.pixels.push_back(pixel);
+		}
+	}
+
+	samples.per_pixel = grid * grid;
+	samples.counts.resize(samples.pixels.size() * samples.per_pixel);
+	if (NULL != smooth)
+	{
+		samples.smooth.resize(samples.counts.size());
+	}
 
-			m_logger->add_logfile_detail(to_string(total_duration) + ' ');
-			m_logger->write_logdetails_to_path();
-			std::cout << "Total time to generate fractals: " << total_duration << " [s]" << std::endl;
+	minstd_rand random(ANTIALIAS_SEED);
+	uniform_real_distribution<double> jitter(0.0, 1.0);
+	vector<double> offsets;
+	for (int j = 0; j < grid; ++j)
+	{
+		for (int i = 0; i < grid; ++i)
+		{
+			offsets.push_back((i + jitter(random)) / grid - 0.5);
+			offsets.push_back((j + jitter(random)) / grid - 0.5);
 		}
-	
-#endif
-		
+	}
+
+	switch (m_formula)
+	{
+	case FIRST_ORDER:
+		supersample(first_order_kernel(), use_threads, offsets, samples);
+		break;
+	case THIRD_ORDER:
+		supersample(third_order_kernel(), use_threads, offsets, samples);
+		break;
+	case MULTIBROT:
+		supersample(multibrot_kernel(m_formula_order), use_threads, offsets, samples);
+		break;
+	default:
+		supersample(custom_kernel(m_mandel_func), use_threads, offsets, samples);
+		break;
+	}
+	double end = omp_get_wtime();
+
+	long long taken = (long long)samples.counts.size();
+	cout << "Antialiasing took " << taken << " samples for " << samples.pixels.size() << " of " << num_pixels
+		 << " pixels (" << (100.0 * samples.pixels.size() / num_pixels) << "%), supersampling all of them would take "
+		 << (long long)num_pixels * samples.per_pixel << ", in " << (end - start) << " [s]" << endl;
+	return taken;
+}
+
+// Renders the image band_rows rows at a time. The render paths only ever look at
+// m_screen_y_min/m_screen_y_max/m_screen_height to decide which rows to compute,
+// so narrowing those onto each band in turn runs any parallelisation type on just
+// that band, while the pixel to complex mapping stays that of the full image.
+template <typename CountT>
+void mandel_plotter::fractal_streamed(parallelisation_type parallel_type, int band_rows,
+									  const std::function<void(int, std::vector<CountT>&, std::vector<float>*)> &band_ready,
+									  bool smooth)
+{
+	if (band_rows <= 0 || band_rows > m_screen_height)
+	{
+		band_rows = m_screen_height;
+	}
+
+	cout << "Computing Mandelbrot Fractals in bands of " << band_rows << " rows please wait..." << endl;
+	if (!begin_render<CountT>())
+	{
+		return;
+	}
+
+	const int screen_y_min = m_screen_y_min;
+	const int screen_y_max = m_screen_y_max;
+	const int screen_height = m_screen_height;
+	vector<CountT> band_colours((size_t)band_rows * m_screen_width);
+	vector<float> band_smooth;
+	double compute_time = 0.0;
+
+	//The mode banners would otherwise be repeated for every band
+	bool verbose = m_verbose;
+	m_verbose = false;
+
+	for (int first_row = 0; first_row < screen_height; first_row += band_rows)
+	{
+		int rows = (first_row + band_rows < screen_height) ? band_rows : screen_height - first_row;
+		m_screen_y_min = screen_y_min + first_row;
+		m_screen_y_max = m_screen_y_min + rows;
+		m_screen_height = rows;
+		band_colours.resize((size_t)rows * m_screen_width);
+
+		double band_start = omp_get_wtime();
+		get_number_iterations(band_colours, parallel_type, smooth ? &band_smooth : NULL);
+		compute_time += omp_get_wtime() - band_start;
+
+		//Only rank 0 ends up with the whole band
+		if (0 >= m_mpi_rank)
+		{
+			band_ready(first_row, band_colours, smooth ? &band_smooth : NULL);
+		}
+	}
+
+	m_screen_y_min = screen_y_min;
+	m_screen_y_max = screen_y_max;
+	m_screen_height = screen_height;
+	m_verbose = verbose;
+
+	//Just the compute time, writing the bands out isn't counted
+	report_render(parallel_type, 0.0, compute_time);
+
+	cout << "Rank: " << m_mpi_rank << " peak RSS: " << mandel_logger::get_peak_rss_kb() << " [kB]" << endl;
 }
 
+// Computes and colours tile by tile. The MPI and subdivision paths only have whole
+// bands to give (the counts have to reach rank 0, or the borders of every tile have
+// to exist, before anything can be coloured), so those go through fractal_streamed
+// with bands one tile high and each band is handed over as a single tile.
+template <typename CountT>
+void mandel_plotter::fractal_fused(parallelisation_type parallel_type, const tile_callback<CountT> &tile_done,
+								   std::vector<CountT> *colours, std::vector<float> *smooth)
+{
+	if (NULL != colours)
+	{
+		colours->resize((size_t)m_screen_width * m_screen_height);
+	}
+	if (NULL != smooth)
+	{
+		smooth->resize((size_t)m_screen_width * m_screen_height);
+	}
+
+	if (NO_PARALLEL != parallel_type && OMP_PARALLEL != parallel_type)
+	{
+		fractal_streamed<CountT>(parallel_type, m_tile_size,
+			[&](int first_row, std::vector<CountT> &band, std::vector<float> *band_smooth)
+		{
+			tile t = { 0, first_row, m_screen_width, first_row + (int)(band.size() / m_screen_width) };
+			tile_done(t, &band[0], (NULL != band_smooth) ? &(*band_smooth)[0] : NULL);
+
+			size_t first = (size_t)first_row * m_screen_width;
+			if (NULL != colours)
+			{
+				std::copy(band.begin(), band.end(), colours->begin() + first);
+			}
+			if (NULL != smooth)
+			{
+				std::copy(band_smooth->begin(), band_smooth->end(), smooth->begin() + first);
+			}
+		}, NULL != smooth);
+		return;
+	}
+
+	cout << "Computing and colouring Mandelbrot Fractals tile by tile please wait..." << endl;
+	if (!begin_render<CountT>())
+	{
+		return;
+	}
+
+	double start = omp_get_wtime();
+	switch (m_formula)
+	{
+	case FIRST_ORDER:
+		compute_fused(first_order_kernel(), parallel_type, tile_done, colours, smooth);
+		break;
+	case THIRD_ORDER:
+		compute_fused(third_order_kernel(), parallel_type, tile_done, colours, smooth);
+		break;
+	case MULTIBROT:
+		compute_fused(multibrot_kernel(m_formula_order), parallel_type, tile_done, colours, smooth);
+		break;
+	default:
+		compute_fused(custom_kernel(m_mandel_func), parallel_type, tile_done, colours, smooth);
+		break;
+	}
+	double end = omp_get_wtime();
+
+	//The time includes the colouring done by tile_done
+	report_render(parallel_type, start, end);
+}
 
+//The count buffers the plotter can render into, see mandel_plotter.hpp
+template void mandel_plotter::get_number_iterations<int>(std::vector<int>&, parallelisation_type, std::vector<float>*);
+template void mandel_plotter::get_number_iterations<uint16_t>(std::vector<uint16_t>&, parallelisation_type, std::vector<float>*);
+template void mandel_plotter::get_number_iterations<uint32_t>(std::vector<uint32_t>&, parallelisation_type, std::vector<float>*);
+template void mandel_plotter::fractal<int>(std::vector<int>&, parallelisation_type, std::vector<float>*);
+template void mandel_plotter::fractal<uint16_t>(std::vector<uint16_t>&, parallelisation_type, std::vector<float>*);
+template void mandel_plotter::fractal<uint32_t>(std::vector<uint32_t>&, parallelisation_type, std::vector<float>*);
+template void mandel_plotter::extend_iterations<int>(std::vector<int>&, parallelisation_type, int, std::vector<float>*);
+template void mandel_plotter::extend_iterations<uint16_t>(std::vector<uint16_t>&, parallelisation_type, int, std::vector<float>*);
+template void mandel_plotter::extend_iterations<uint32_t>(std::vector<uint32_t>&, parallelisation_type, int, std::vector<float>*);
+template void mandel_plotter::fractal_reuse<int>(std::vector<int>&, parallelisation_type, window<double>, const std::vector<int>&,
+												  std::vector<float>*, const std::vector<float>*);
+template void mandel_plotter::fractal_reuse<uint16_t>(std::vector<uint16_t>&, parallelisation_type, window<double>, const std::vector<uint16_t>&,
+												  std::vector<float>*, const std::vector<float>*);
+template void mandel_plotter::fractal_reuse<uint32_t>(std::vector<uint32_t>&, parallelisation_type, window<double>, const std::vector<uint32_t>&,
+												  std::vector<float>*, const std::vector<float>*);
+template void mandel_plotter::fractal_progressive<int>(std::vector<int>&, parallelisation_type,
+														const pass_callback<int>&, std::vector<float>*);
+template void mandel_plotter::fractal_progressive<uint16_t>(std::vector<uint16_t>&, parallelisation_type,
+														const pass_callback<uint16_t>&, std::vector<float>*);
+template void mandel_plotter::fractal_progressive<uint32_t>(std::vector<uint32_t>&, parallelisation_type,
+														const pass_callback<uint32_t>&, std::vector<float>*);
+template long long mandel_plotter::antialias<int>(const std::vector<int>&, parallelisation_type, antialias_samples&,
+														const std::vector<float>*, int, double);
+template long long mandel_plotter::antialias<uint16_t>(const std::vector<uint16_t>&, parallelisation_type, antialias_samples&,
+														const std::vector<float>*, int, double);
+template long long mandel_plotter::antialias<uint32_t>(const std::vector<uint32_t>&, parallelisation_type, antialias_samples&,
+														const std::vector<float>*, int, double);
+template void mandel_plotter::fractal_streamed<int>(parallelisation_type, int,
+	const std::function<void(int, std::vector<int>&, std::vector<float>*)>&, bool);
+template void mandel_plotter::fractal_streamed<uint16_t>(parallelisation_type, int,
+	const std::function<void(int, std::vector<uint16_t>&, std::vector<float>*)>&, bool);
+template void mandel_plotter::fractal_streamed<uint32_t>(parallelisation_type, int,
+	const std::function<void(int, std::vector<uint32_t>&, std::vector<float>*)>&, bool);
+template void mandel_plotter::fractal_fused<int>(parallelisation_type, const tile_callback<int>&,
+	std::vector<int>*, std::vector<float>*);
+template void mandel_plotter::fractal_fused<uint16_t>(parallelisation_type, const tile_callback<uint16_t>&,
+	std::vector<uint16_t>*, std::vector<float>*);
+template void mandel_plotter::fractal_fused<uint32_t>(parallelisation_type, const tile_callback<uint32_t>&,
+	std::vector<uint32_t>*, std::vector<float>*);
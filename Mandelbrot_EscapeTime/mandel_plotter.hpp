@@ -4,23 +4,66 @@
 #define _MANDEL_PLOTTER_HPP
 
 #include <complex>
+#include <cstdint>
 #include <functional>
 #include <stdbool.h>
+#include <string>
 #include <vector>
 
 #include "window.hpp"
+#include "antialias.hpp"
 #include "mandel_logger.hpp"
-
-// Use an alias to simplify the use of complex type
-using Complex = std::complex<double>;
+#include "mandel_kernels.hpp"
+#include "mandel_simd.hpp"
+#include "extended_precision.hpp"
+#include "perturbation.hpp"
+#include "tile_scheduler.hpp"
 
 enum parallelisation_type
 {
 	NO_PARALLEL,
 	OMP_PARALLEL,
 	MPI_PARALLEL,
-	BOTH_PARALLEL
+	BOTH_PARALLEL,
+	SUBDIVIDE_PARALLEL	//Mariani-Silver rectangle subdivision, OpenMP tasks over tiles
+};
+
+//How MPI_PARALLEL and BOTH_PARALLEL split the image between ranks
+enum mpi_schedule_type
+{
+	MPI_SCHEDULE_STATIC,	//Bands dealt round robin, gathered collectively
+	MPI_SCHEDULE_DYNAMIC	//Rank 0 hands out row bands on demand
+};
+
+//Receives a finished tile from fractal_fused, counts (and smooth if it was asked
+//for) are row-major and as wide as the tile
+template <typename CountT>
+using tile_callback = std::function<void(const tile&, const CountT*, const float*)>;
+
+//Receives the whole frame from fractal_progressive after each pass. step is how far
+//apart the pixels computed so far are, the ones in between are copies of the computed
+//pixel above and to the left of them.
+template <typename CountT>
+using pass_callback = std::function<void(int, const std::vector<CountT>&, const std::vector<float>*)>;
+
+//How the float render compared with double on the sampled pixels
+struct float_validation_stats
+{
+	long long sampled;
+	long long mismatched;
+	int max_difference;
 };
+
+//Pixels a render left at the iteration cap with z where it stopped, so a later
+//render with a higher cap can carry on from there
+struct saved_orbits
+{
+	int iter_max;				//Cap they were iterated to, 0 when nothing is saved
+	std::string key;			//get_cache_key of that render, to tell if the view changed
+	std::vector<size_t> pixels;	//Index into the count buffer
+	std::vector<double> z;		//Re/im pairs
+};
+
 /***************************************************************
 
 BEGIN CLASS::MANDEL_PLOTTER
@@ -60,23 +103,286 @@ private:
 	double m_real_factor;
 	double m_imaginary_factor;
 
-	//This will hold the chosen mandelbrot function 
+	//This will hold the chosen mandelbrot function, only used directly
+	//when it couldn't be mapped onto one of the specialised kernels
 	const std::function<Complex(Complex, Complex)> m_mandel_func;
 
+	//The kernel selected at construction and its order (for MULTIBROT)
+	mandel_formula m_formula;
+	int m_formula_order;
+
+	//log(m_formula_order), used to normalise the smooth counts
+	double m_log_order;
+
+	//Vector unit used for the kernels that have a SIMD loop
+	simd_level m_simd_level;
+
+	//Shared memory work distribution, tiles are m_tile_size square
+	tile_scheduler m_scheduler;
+	int m_tile_size;
+
+	//MPI work distribution and the band height for the dynamic schedule
+	mpi_schedule_type m_mpi_schedule;
+	int m_mpi_band_rows;
+
+	//interior_check flags for the render, and how many pixels each one saved
+	int m_interior_checks;
+	interior_stats m_interior_stats;
+
+	//Deep zoom rendering against a high precision reference orbit. The centre is
+	//kept as the decimal strings it was given, empty takes it from the window.
+	bool m_perturbation;
+	bool m_perturbation_active;
+	bool m_series_approximation;
+	std::string m_centre_real;
+	std::string m_centre_imaginary;
+	reference_orbit m_reference;
+	perturbation_stats m_perturbation_stats;
+
+	//Pixel the primary reference sits on, the middle of the full screen
+	double m_reference_x;
+	double m_reference_y;
+
+	//Scalar asked for and the one the current render uses. Anything other than
+	//double iterates c = centre + pixel offset, with the centre held at full precision.
+	scalar_type m_scalar_type;
+	scalar_type m_active_scalar;
+	fixed_point m_extended_real;
+	fixed_point m_extended_imaginary;
+
+	//Pixels fractal re-checks in double after a float render, 0 for none
+	int m_float_validation_samples;
+	float_validation_stats m_float_validation;
+
+	//Keep the orbits of the pixels that reach the cap, whether the current render
+	//does, and what the last one kept
+	bool m_orbit_saving;
+	bool m_orbits_active;
+	saved_orbits m_saved_orbits;
+
 	mandel_logger* m_logger;
 
+	//Print the parallelisation mode etc. for each call of get_number_iterations
+	bool m_verbose;
+
+	//Shared by both constructors
+	void init_plotter(window<int> &screen, window<double> &fractal);
+
+	//Kernel for formula, collapsing the multibrot orders that have their own.
+	//CUSTOM_FORMULA needs the plotter to have been given a function.
+	void select_formula(mandel_formula formula, int order);
+
+	//Pixel extent and the reference pixel in the middle of it
+	void set_screen(window<int> &screen);
+
+	//Instantiated once per kernel so the iteration loop is fully inlined, and once
+	//per count type. smooth is the matching part of the smooth channel or NULL.
+	template <typename Kernel>
+	int escape_pixel(const Kernel &kernel, double cr, double ci, float *smooth, interior_stats &stats);
+
+	template <typename Kernel>
+	int escape_pixel_float(const Kernel &kernel, double cr, double ci, float *smooth, interior_stats &stats);
+
+	template <typename Kernel, typename CountT>
+	void compute_span(const Kernel &kernel, int y, int x_begin, int x_end, CountT *out, float *smooth);
+
+	//compute_span for a render that keeps its orbits, the pixels it leaves at the cap
+	//are added to m_saved_orbits
+	template <typename Kernel, typename CountT>
+	void orbit_span(const Kernel &kernel, int y, int x_begin, int x_end, CountT *out, float *smooth);
+
+	//Carries the saved pixels on from previous_iter_max to m_iter_max
+	template <typename Kernel, typename CountT>
+	void extend_orbits(const Kernel &kernel, std::vector<CountT> &colours, std::vector<float> *smooth,
+					   parallelisation_type parallel_type, int previous_iter_max);
+
+	//The rows of fractal_reuse, pixels with a match in both axes are copied from
+	//previous and the runs between them computed. Returns how many were copied.
+	template <typename Kernel, typename CountT>
+	long long reuse_rows(const Kernel &kernel, parallelisation_type parallel_type, std::vector<CountT> &colours,
+						 float *smooth, const std::vector<CountT> &previous, const float *previous_smooth,
+						 const std::vector<int> &match_x, const std::vector<int> &match_y);
+
+	//One pass of fractal_progressive, computes the pixels on multiples of step that the
+	//pass at twice the step didn't and fills in the ones between them
+	template <typename Kernel, typename CountT>
+	void progressive_pass(const Kernel &kernel, parallelisation_type parallel_type, int step, bool first_pass,
+						  std::vector<CountT> &colours, float *smooth);
+
+	//Counts of a grid of samples_x by samples_y pixels spread over the screen, at the
+	//current cap, for estimate_iter_max
+	template <typename Kernel>
+	void sample_grid(const Kernel &kernel, int samples_x, int samples_y, std::vector<int> &counts);
+
+	//Iterates the pixels in samples at each of the offsets (in pixels from their
+	//centres), one pass over them per offset
+	template <typename Kernel>
+	void supersample(const Kernel &kernel, bool use_threads, const std::vector<double> &offsets,
+					 antialias_samples &samples);
+
+	template <typename Kernel, typename CountT>
+	void compute_column(const Kernel &kernel, int x, int y_begin, int y_end, CountT *out, float *smooth,
+						size_t stride);
+
+	//Perturbation replacement for compute_span / compute_column, the pixels
+	//[x_begin, x_end) x [y_begin, y_end) go to out[(y - y_begin) * stride + x - x_begin]
+	template <typename CountT>
+	void perturb_rect(int x_begin, int x_end, int y_begin, int y_end, CountT *out, float *smooth, size_t stride);
+
+	//Computes the primary reference orbit, false if perturbation can't be used
+	bool prepare_perturbation(void);
+
+	//The view centre (the reference pixel) in fixed point, from set_centre or the window
+	void get_centre(int num_limbs, fixed_point &real, fixed_point &imaginary);
+
+	//Works out m_active_scalar for the render
+	void prepare_scalar_type(void);
+
+	template <typename CountT>
+	void validate_float(const std::vector<CountT> &colours);
+
+	//Same layout as perturb_rect, iterated directly in m_active_scalar
+	template <typename CountT>
+	void extended_rect(int x_begin, int x_end, int y_begin, int y_end, CountT *out, float *smooth, size_t stride);
+
+	template <typename Scalar, typename CountT>
+	void extended_rect_as(int x_begin, int x_end, int y_begin, int y_end, CountT *out, float *smooth, size_t stride);
+
+	template <typename Kernel, typename CountT>
+	void compute_range(const Kernel &kernel, size_t first, size_t last, CountT *out, float *smooth);
+
+	template <typename Kernel, typename CountT>
+	void compute_tiles(const Kernel &kernel, size_t first, size_t last, CountT *out, float *smooth);
+
+	template <typename Kernel, typename CountT>
+	void compute_mpi_static(const Kernel &kernel, std::vector<CountT> &colours, float *smooth, bool use_threads);
+
+	template <typename Kernel, typename CountT>
+	void compute_mpi_dynamic(const Kernel &kernel, std::vector<CountT> &colours, float *smooth, bool use_threads);
+
+	template <typename Kernel, typename CountT>
+	void subdivide_rect(const Kernel &kernel, int x0, int y0, int x1, int y1, CountT *colours, float *smooth,
+						long long &computed, long long &filled);
+
+	template <typename Kernel, typename CountT>
+	void get_number_iterations(std::vector<CountT> &colours, parallelisation_type parallel_type,
+							   const Kernel &kernel, float *smooth);
+
+	template <typename Kernel, typename CountT>
+	void compute_fused(const Kernel &kernel, parallelisation_type parallel_type, const tile_callback<CountT> &tile_done,
+					   std::vector<CountT> *colours, std::vector<float> *smooth);
+
+	//Shared by fractal, fractal_streamed and fractal_fused
+	template <typename CountT>
+	bool begin_render(void);
+
+	void report_render(parallelisation_type parallel_type, double start, double end);
+
 public:
 
+	//Any function matching z^2 + c or z^3 + c is automatically mapped onto
+	//the specialised kernel, anything else falls back to calling mandel_func
 	mandel_plotter(	window<int> screen, 
 					window<double> fractal, 
 					int iter_max, 
 					const std::function<Complex(Complex, Complex)> &mandel_func,
 					mandel_logger* logger);
 
+	//Select a kernel directly, order is only used for MULTIBROT
+	mandel_plotter(	window<int> screen,
+					window<double> fractal,
+					int iter_max,
+					mandel_formula formula,
+					mandel_logger* logger,
+					int order = 2);
+
 	~mandel_plotter();
 
 	//Utility
 
+	//Cap for the next render, estimate_iter_max can pick one
+	void set_iter_max(int iter_max);
+
+	int get_iter_max(void);
+
+	//Defaults to the widest level the CPU supports, SIMD_SCALAR disables vectorisation
+	void set_simd_level(simd_level level);
+
+	simd_level get_simd_level(void);
+
+	//Edge length of the tiles used by OMP_PARALLEL and BOTH_PARALLEL
+	void set_tile_size(int tile_size);
+
+	//Threads per rank, 0 uses all of the cores OpenMP reports
+	void set_num_threads(int num_threads);
+
+	//Defaults to MPI_SCHEDULE_DYNAMIC, band_rows <= 0 keeps the current band height
+	void set_mpi_schedule(mpi_schedule_type schedule, int band_rows = 0);
+
+	//Takes interior_check flags, INTERIOR_NONE runs every pixel to the end.
+	//The counts are identical either way, only the time taken changes.
+	void set_interior_checks(int checks);
+
+	//Shortcut counters from the last call to fractal
+	interior_stats get_interior_stats(void);
+
+	//Iterate the pixels as offsets from a high precision reference orbit, needed
+	//for zooms much past 1e-13. Only the first order formula supports it and the
+	//interior checks are ignored while it is on.
+	void set_perturbation(bool enabled);
+
+	//Centres the view on real + i imaginary, given as decimal strings so they can
+	//carry more digits than a double, with width the real extent of the image.
+	//The double window is moved to match. Returns false if they don't parse.
+	bool set_centre(const std::string &real, const std::string &imaginary, double width);
+
+	//Start each pixel part way into its orbit using a series expansion around the
+	//reference, checked against the corners of every span. Only has an effect with
+	//perturbation on, and only saves time at deep zooms with long orbits.
+	void set_series_approximation(bool enabled);
+
+	//Scalar type the pixels are iterated in when perturbation is off. Defaults to
+	//SCALAR_AUTO, which uses float for overviews where the pixels are far enough
+	//apart, then double (and the SIMD loops) until the pixel spacing gets too fine
+	//for it. float needs the first or third order formula, the wider types the first.
+	void set_scalar_type(scalar_type type);
+
+	//After a float render, fractal recomputes this many pixels spread over the image
+	//in double and reports how many differ. 0 (the default) turns it off.
+	void set_float_validation(int samples);
+
+	float_validation_stats get_float_validation(void);
+
+	//Reference and glitch counters from the last call to fractal
+	perturbation_stats get_perturbation_stats(void);
+
+	//Moves the view to fractal, taken the same way as by the constructor, for the next
+	//render. Clears a centre given to set_centre.
+	void set_window(window<double> fractal);
+
+	//The current view, with the maximum imaginary part worked out from the aspect
+	window<double> get_window(void);
+
+	//Moves the plotter onto a new view, screen size and all, without rebuilding it,
+	//so a batch of renders shares one plotter. Same formula rules as the constructor.
+	void set_view(window<int> screen, window<double> fractal, int iter_max, mandel_formula formula, int order = 2);
+
+	//Keep z of the pixels that reach the cap in fractal, 24 bytes for each of them, so
+	//extend_iterations can carry them on. Only double precision renders with NO_PARALLEL
+	//or OMP_PARALLEL keep them, the other paths don't have all of the pixels on one rank.
+	void set_orbit_saving(bool enabled);
+
+	//Iterates a sparse grid over the view up to ceiling and returns the smallest cap
+	//that target_fraction of the samples which escape get out under, so the boundary
+	//is resolved without running the interior any longer than that. Doesn't change
+	//the cap, pass the result to set_iter_max. Every rank gets the same estimate.
+	int estimate_iter_max(double target_fraction = 0.995, int ceiling = 100000);
+
+	//Everything that decides the counts a render with parallel_type gives (window,
+	//screen, iteration cap, formula and the precision settings), as the key for an
+	//iteration_cache entry. Empty for a custom formula, which can't be told apart.
+	std::string get_cache_key(parallelisation_type parallel_type);
+
 	//Core
 
 	Complex pixel_to_complex(Complex complex);
@@ -85,9 +391,68 @@ public:
 
 	int check_value_within_set(Complex c);
 
-	void get_number_iterations(std::vector<int> &colours, parallelisation_type parallel_type);
-
-	void fractal(std::vector<int> &colours, parallelisation_type parallel_type);
+	//CountT is int, uint16_t or uint32_t, the narrower types halve the memory and
+	//MPI traffic but m_iter_max has to fit. If smooth isn't NULL it is resized to
+	//match colours and filled with the fractional escape counts as well.
+	template <typename CountT>
+	void get_number_iterations(std::vector<CountT> &colours, parallelisation_type parallel_type,
+							   std::vector<float> *smooth = NULL);
+
+	template <typename CountT>
+	void fractal(std::vector<CountT> &colours, parallelisation_type parallel_type, std::vector<float> *smooth = NULL);
+
+	//Raises the cap to iter_max. If the last fractal call kept its orbits and the view
+	//hasn't changed since, only the pixels it left at the cap are iterated further and
+	//colours, which must still hold its counts, is updated in place. Otherwise this is
+	//a full render at the new cap. smooth, if given, has to be from the same render.
+	template <typename CountT>
+	void extend_iterations(std::vector<CountT> &colours, parallelisation_type parallel_type, int iter_max,
+						   std::vector<float> *smooth = NULL);
+
+	//Renders the current view reusing the counts of a previous frame (previous, rendered
+	//at previous_fractal with the same screen, cap and formula) wherever a pixel lands
+	//on one of its pixels. A pan by whole pixels only computes the exposed strip and an
+	//integer zoom in by k keeps every k'th pixel of every k'th row. NO_PARALLEL and
+	//OMP_PARALLEL only, anything else (or perturbation) is a full render.
+	template <typename CountT>
+	void fractal_reuse(std::vector<CountT> &colours, parallelisation_type parallel_type, window<double> previous_fractal,
+					   const std::vector<CountT> &previous, std::vector<float> *smooth = NULL,
+					   const std::vector<float> *previous_smooth = NULL);
+
+	//Renders every 4th pixel of every 4th row, then every 2nd, then the rest, calling
+	//pass_done with the whole frame after each pass. Each pass only computes the pixels
+	//the ones before it didn't and the final counts match fractal. NO_PARALLEL and
+	//OMP_PARALLEL only, anything else is a single full pass.
+	template <typename CountT>
+	void fractal_progressive(std::vector<CountT> &colours, parallelisation_type parallel_type,
+							 const pass_callback<CountT> &pass_done, std::vector<float> *smooth = NULL);
+
+	//Picks the pixels of a finished render whose count (smooth count if smooth isn't
+	//NULL) differs from one of its 8 neighbours' by more than threshold times the cap
+	//and iterates grid x grid jittered points inside each of them into samples, for
+	//image_handler::write_image. Doesn't communicate, call it where the whole of colours
+	//is (rank 0 with MPI), every type but NO_PARALLEL and MPI_PARALLEL uses the threads.
+	//Returns how many samples it took.
+	template <typename CountT>
+	long long antialias(const std::vector<CountT> &colours, parallelisation_type parallel_type,
+						antialias_samples &samples, const std::vector<float> *smooth = NULL, int grid = 4,
+						double threshold = 0.02);
+
+	//Renders band_rows rows at a time into a buffer of just that size, calling band_ready
+	//on rank 0 with the first row and counts (and smooth counts if asked for) of each band
+	//in turn, so memory use follows the band height rather than the image size.
+	//band_rows <= 0 does the whole image as a single band.
+	template <typename CountT>
+	void fractal_streamed(parallelisation_type parallel_type, int band_rows,
+						  const std::function<void(int, std::vector<CountT>&, std::vector<float>*)> &band_ready,
+						  bool smooth = false);
+
+	//Calls tile_done on rank 0 with each tile as soon as it has been computed, so it
+	//can be coloured while the counts are still in cache. The counts are only kept
+	//in colours if it isn't NULL, smooth isn't NULL asks for (and keeps) the smooth counts.
+	template <typename CountT>
+	void fractal_fused(parallelisation_type parallel_type, const tile_callback<CountT> &tile_done,
+					   std::vector<CountT> *colours = NULL, std::vector<float> *smooth = NULL);
 };
 
 /*
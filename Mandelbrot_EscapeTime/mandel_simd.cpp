@@ -0,0 +1,947 @@
+/*
+	AVX2 / AVX-512 escape time loops and the AVX2 palette lookup, selected at runtime.
+
+	Each ISA specific function is compiled with a target attribute rather
+	than building the whole project with -mavx2, so the binary still runs
+	(using the scalar loop) on machines without them. FMA is deliberately
+	not enabled so the results stay bit identical to the scalar kernels.
+*/
+
+#include "mandel_simd.hpp"
+
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MANDEL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(MANDEL_SIMD_X86)
+#include <intrin.h>
+#endif
+
+//AVX-512F implies FMA, so stop the compiler fusing the multiplies and adds itself
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+
+#if defined(__GNUC__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+simd_level detect_simd_level(void)
+{
+#if defined(MANDEL_SIMD_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return SIMD_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return SIMD_AVX2;
+	}
+#elif defined(MANDEL_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (7 <= info[0])
+	{
+		__cpuid(info, 1);
+		bool os_saves_ymm = (0 != (info[2] & (1 << 27))) && (0x6 == (_xgetbv(0) & 0x6));
+		bool os_saves_zmm = os_saves_ymm && (0xE0 == (_xgetbv(0) & 0xE0));
+
+		__cpuidex(info, 7, 0);
+		if (os_saves_zmm && (0 != (info[1] & (1 << 16))))
+		{
+			return SIMD_AVX512;
+		}
+		if (os_saves_ymm && (0 != (info[1] & (1 << 5))))
+		{
+			return SIMD_AVX2;
+		}
+	}
+#endif
+	return SIMD_SCALAR;
+}
+
+const char* simd_level_name(simd_level level)
+{
+	switch (level)
+	{
+	case SIMD_AVX2:
+		return "AVX2";
+	case SIMD_AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
+
+int simd_lane_count(simd_level level)
+{
+	switch (level)
+	{
+	case SIMD_AVX2:
+		return 4;
+	case SIMD_AVX512:
+		return 8;
+	default:
+		return 1;
+	}
+}
+
+#if defined(MANDEL_SIMD_X86)
+
+//Only ever called on 4 or 8 bit masks, not worth needing POPCNT for
+static inline int count_set_lanes(int mask)
+{
+	int set = 0;
+	for (; 0 != mask; mask >>= 1)
+	{
+		set += mask & 1;
+	}
+	return set;
+}
+
+//Fractional counts for one vector of lanes from the z each of them escaped with. The
+//few extra iterations and the logs are done a lane at a time with the scalar helper,
+//which keeps them identical to the scalar path and costs little next to the loop.
+template <int Order, typename Lane>
+static void smooth_lanes(const int *counts, const Lane *zr, const Lane *zi, const Lane *cr, const Lane *ci,
+						 int lanes, int iter_max, float *smooth)
+{
+	const double log_order = std::log((double)Order);
+	for (int l = 0; l < lanes; ++l)
+	{
+		smooth[l] = (2 == Order) ?
+			smooth_iteration_count(first_order_kernel(), counts[l], zr[l], zi[l], cr[l], ci[l], iter_max, log_order) :
+			smooth_iteration_count(third_order_kernel(), counts[l], zr[l], zi[l], cr[l], ci[l], iter_max, log_order);
+	}
+}
+
+/***************************************************************
+
+							AVX2
+
+****************************************************************/
+
+template <int Order>
+SIMD_TARGET_AVX2 static inline void avx2_step(__m256d &zr, __m256d &zi, __m256d cr, __m256d ci)
+{
+	if (2 == Order)
+	{
+		__m256d zr2 = _mm256_mul_pd(zr, zr);
+		__m256d zi2 = _mm256_mul_pd(zi, zi);
+		zi = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), zr), zi), ci);
+		zr = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cr);
+	}
+	else
+	{
+		__m256d wr = _mm256_sub_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+		__m256d wi = _mm256_add_pd(_mm256_mul_pd(zr, zi), _mm256_mul_pd(zi, zr));
+		__m256d tr = _mm256_sub_pd(_mm256_mul_pd(wr, zr), _mm256_mul_pd(wi, zi));
+		__m256d ti = _mm256_add_pd(_mm256_mul_pd(wr, zi), _mm256_mul_pd(wi, zr));
+		zr = _mm256_add_pd(tr, cr);
+		zi = _mm256_add_pd(ti, ci);
+	}
+}
+
+//Iterates count pixels starting at pixel index first, along a row (cr = origin + index * step,
+//ci = fixed) or for Column down a column (cr = fixed, ci = origin - index * step). With
+//Smooth each lane also keeps z from the iteration it escaped at, for the fractional count.
+//If final_z isn't NULL it gets z of every pixel where the loop left it as re/im pairs,
+//NaN for those the interior checks resolved as they will never escape.
+template <int Order, bool Periodic, bool Column, bool Smooth, typename CountT>
+SIMD_TARGET_AVX2 static void avx2_escape_line(double origin, double step, int first, double fixed,
+							 int count, int iter_max, bool cardioid, CountT *out, float *smooth,
+							 double *final_z, interior_stats &stats)
+{
+	const __m256d four = _mm256_set1_pd(4.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d lane_offsets = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+	const __m256d all_set = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+	for (int n = 0; n < count; n += 4)
+	{
+		__m256d index = _mm256_add_pd(_mm256_set1_pd((double)(first + n)), lane_offsets);
+		__m256d cr, ci;
+		if (Column)
+		{
+			cr = _mm256_set1_pd(fixed);
+			ci = _mm256_sub_pd(_mm256_set1_pd(origin), _mm256_mul_pd(index, _mm256_set1_pd(step)));
+		}
+		else
+		{
+			cr = _mm256_add_pd(_mm256_set1_pd(origin), _mm256_mul_pd(index, _mm256_set1_pd(step)));
+			ci = _mm256_set1_pd(fixed);
+		}
+		__m256d zr = cr;
+		__m256d zi = ci;
+		__m256d iters = _mm256_setzero_pd();
+		__m256d active = all_set;
+		__m256d resolved = _mm256_setzero_pd();
+		int valid_lanes = (count - n < 4) ? (1 << (count - n)) - 1 : 0xF;
+
+		//Same tests as in_cardioid_or_bulb, lanes inside are never iterated
+		if (cardioid)
+		{
+			__m256d xq = _mm256_sub_pd(cr, _mm256_set1_pd(0.25));
+			__m256d ci2 = _mm256_mul_pd(ci, ci);
+			__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), ci2);
+			__m256d in_cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)),
+												_mm256_mul_pd(_mm256_set1_pd(0.25), ci2), _CMP_LE_OQ);
+			__m256d xb = _mm256_add_pd(cr, one);
+			__m256d in_bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(xb, xb), ci2),
+											_mm256_set1_pd(0.0625), _CMP_LE_OQ);
+			resolved = _mm256_or_pd(in_cardioid, in_bulb);
+			active = _mm256_andnot_pd(resolved, active);
+			stats.cardioid += count_set_lanes(_mm256_movemask_pd(resolved) & valid_lanes);
+		}
+
+		__m256d saved_r = zr;
+		__m256d saved_i = zi;
+		__m256d cycled = _mm256_setzero_pd();
+		__m256d escaped_r = zr;
+		__m256d escaped_i = zi;
+		int save_at = 1;
+
+		for (int iter = 0; iter < iter_max; ++iter)
+		{
+			__m256d mag = _mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+			__m256d inside = _mm256_and_pd(active, _mm256_cmp_pd(mag, four, _CMP_LT_OQ));
+			if (Smooth)
+			{
+				__m256d leaving = _mm256_andnot_pd(inside, active);
+				escaped_r = _mm256_blendv_pd(escaped_r, zr, leaving);
+				escaped_i = _mm256_blendv_pd(escaped_i, zi, leaving);
+			}
+			active = inside;
+			if (0 == _mm256_movemask_pd(active))
+			{
+				break;
+			}
+			iters = _mm256_add_pd(iters, _mm256_and_pd(active, one));
+			avx2_step<Order>(zr, zi, cr, ci);
+
+			if (Periodic)
+			{
+				__m256d same = _mm256_and_pd(_mm256_cmp_pd(zr, saved_r, _CMP_EQ_OQ),
+											 _mm256_cmp_pd(zi, saved_i, _CMP_EQ_OQ));
+				same = _mm256_and_pd(same, active);
+				cycled = _mm256_or_pd(cycled, same);
+				active = _mm256_andnot_pd(same, active);
+				if (iter + 1 == save_at)
+				{
+					saved_r = zr;
+					saved_i = zi;
+					save_at <<= 1;
+				}
+			}
+		}
+
+		if (Periodic)
+		{
+			stats.periodic += count_set_lanes(_mm256_movemask_pd(cycled) & valid_lanes);
+			resolved = _mm256_or_pd(resolved, cycled);
+		}
+		//Interior lanes get the full count, same as if they'd been iterated
+		iters = _mm256_blendv_pd(iters, _mm256_set1_pd((double)iter_max), resolved);
+
+		int lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, _mm256_cvtpd_epi32(iters));
+		for (int l = 0; l < 4 && n + l < count; ++l)
+		{
+			out[n + l] = (CountT)lanes[l];
+		}
+
+		if (NULL != final_z)
+		{
+			const __m256d nan = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+			double lane_zr[4], lane_zi[4];
+			_mm256_storeu_pd(lane_zr, _mm256_blendv_pd(zr, nan, resolved));
+			_mm256_storeu_pd(lane_zi, _mm256_blendv_pd(zi, nan, resolved));
+			for (int l = 0; l < 4 && n + l < count; ++l)
+			{
+				final_z[2 * (n + l)] = lane_zr[l];
+				final_z[2 * (n + l) + 1] = lane_zi[l];
+			}
+		}
+
+		if (Smooth)
+		{
+			double lane_zr[4], lane_zi[4], lane_cr[4], lane_ci[4];
+			_mm256_storeu_pd(lane_zr, escaped_r);
+			_mm256_storeu_pd(lane_zi, escaped_i);
+			_mm256_storeu_pd(lane_cr, cr);
+			_mm256_storeu_pd(lane_ci, ci);
+			smooth_lanes<Order>(lanes, lane_zr, lane_zi, lane_cr, lane_ci, (count - n < 4) ? count - n : 4,
+								iter_max, smooth + n);
+		}
+	}
+}
+
+/***************************************************************
+
+							AVX-512
+
+****************************************************************/
+
+template <int Order>
+SIMD_TARGET_AVX512 static inline void avx512_step(__m512d &zr, __m512d &zi, __m512d cr, __m512d ci)
+{
+	if (2 == Order)
+	{
+		__m512d zr2 = _mm512_mul_pd(zr, zr);
+		__m512d zi2 = _mm512_mul_pd(zi, zi);
+		zi = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(2.0), zr), zi), ci);
+		zr = _mm512_add_pd(_mm512_sub_pd(zr2, zi2), cr);
+	}
+	else
+	{
+		__m512d wr = _mm512_sub_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi));
+		__m512d wi = _mm512_add_pd(_mm512_mul_pd(zr, zi), _mm512_mul_pd(zi, zr));
+		__m512d tr = _mm512_sub_pd(_mm512_mul_pd(wr, zr), _mm512_mul_pd(wi, zi));
+		__m512d ti = _mm512_add_pd(_mm512_mul_pd(wr, zi), _mm512_mul_pd(wi, zr));
+		zr = _mm512_add_pd(tr, cr);
+		zi = _mm512_add_pd(ti, ci);
+	}
+}
+
+//AVX-512 version of avx2_escape_line
+template <int Order, bool Periodic, bool Column, bool Smooth, typename CountT>
+SIMD_TARGET_AVX512 static void avx512_escape_line(double origin, double step, int first, double fixed,
+							 int count, int iter_max, bool cardioid, CountT *out, float *smooth,
+							 double *final_z, interior_stats &stats)
+{
+	const __m512d four = _mm512_set1_pd(4.0);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d lane_offsets = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+
+	for (int n = 0; n < count; n += 8)
+	{
+		__m512d index = _mm512_add_pd(_mm512_set1_pd((double)(first + n)), lane_offsets);
+		__m512d cr, ci;
+		if (Column)
+		{
+			cr = _mm512_set1_pd(fixed);
+			ci = _mm512_sub_pd(_mm512_set1_pd(origin), _mm512_mul_pd(index, _mm512_set1_pd(step)));
+		}
+		else
+		{
+			cr = _mm512_add_pd(_mm512_set1_pd(origin), _mm512_mul_pd(index, _mm512_set1_pd(step)));
+			ci = _mm512_set1_pd(fixed);
+		}
+		__m512d zr = cr;
+		__m512d zi = ci;
+		__m512d iters = _mm512_setzero_pd();
+		__mmask8 active = 0xFF;
+		__mmask8 resolved = 0;
+		__mmask8 valid_lanes = (count - n < 8) ? (__mmask8)((1 << (count - n)) - 1) : (__mmask8)0xFF;
+
+		//Same tests as in_cardioid_or_bulb, lanes inside are never iterated
+		if (cardioid)
+		{
+			__m512d xq = _mm512_sub_pd(cr, _mm512_set1_pd(0.25));
+			__m512d ci2 = _mm512_mul_pd(ci, ci);
+			__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), ci2);
+			__mmask8 in_cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)),
+													  _mm512_mul_pd(_mm512_set1_pd(0.25), ci2), _CMP_LE_OQ);
+			__m512d xb = _mm512_add_pd(cr, one);
+			__mmask8 in_bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(xb, xb), ci2),
+												  _mm512_set1_pd(0.0625), _CMP_LE_OQ);
+			resolved = in_cardioid | in_bulb;
+			active &= (__mmask8)~resolved;
+			stats.cardioid += count_set_lanes(resolved & valid_lanes);
+		}
+
+		__m512d saved_r = zr;
+		__m512d saved_i = zi;
+		__mmask8 cycled = 0;
+		__m512d escaped_r = zr;
+		__m512d escaped_i = zi;
+		int save_at = 1;
+
+		for (int iter = 0; iter < iter_max; ++iter)
+		{
+			__m512d mag = _mm512_add_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi));
+			__mmask8 inside = _mm512_mask_cmp_pd_mask(active, mag, four, _CMP_LT_OQ);
+			if (Smooth)
+			{
+				__mmask8 leaving = active & (__mmask8)~inside;
+				escaped_r = _mm512_mask_mov_pd(escaped_r, leaving, zr);
+				escaped_i = _mm512_mask_mov_pd(escaped_i, leaving, zi);
+			}
+			active = inside;
+			if (0 == active)
+			{
+				break;
+			}
+			iters = _mm512_mask_add_pd(iters, active, iters, one);
+			avx512_step<Order>(zr, zi, cr, ci);
+
+			if (Periodic)
+			{
+				__mmask8 same = _mm512_mask_cmp_pd_mask(active, zr, saved_r, _CMP_EQ_OQ);
+				same = _mm512_mask_cmp_pd_mask(same, zi, saved_i, _CMP_EQ_OQ);
+				cycled |= same;
+				active &= (__mmask8)~same;
+				if (iter + 1 == save_at)
+				{
+					saved_r = zr;
+					saved_i = zi;
+					save_at <<= 1;
+				}
+			}
+		}
+
+		if (Periodic)
+		{
+			stats.periodic += count_set_lanes(cycled & valid_lanes);
+			resolved |= cycled;
+		}
+		//Interior lanes get the full count, same as if they'd been iterated
+		iters = _mm512_mask_mov_pd(iters, resolved, _mm512_set1_pd((double)iter_max));
+
+		int lanes[8];
+		_mm256_storeu_si256((__m256i*)lanes, _mm512_cvtpd_epi32(iters));
+		for (int l = 0; l < 8 && n + l < count; ++l)
+		{
+			out[n + l] = (CountT)lanes[l];
+		}
+
+		if (NULL != final_z)
+		{
+			const __m512d nan = _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN());
+			double lane_zr[8], lane_zi[8];
+			_mm512_storeu_pd(lane_zr, _mm512_mask_mov_pd(zr, resolved, nan));
+			_mm512_storeu_pd(lane_zi, _mm512_mask_mov_pd(zi, resolved, nan));
+			for (int l = 0; l < 8 && n + l < count; ++l)
+			{
+				final_z[2 * (n + l)] = lane_zr[l];
+				final_z[2 * (n + l) + 1] = lane_zi[l];
+			}
+		}
+
+		if (Smooth)
+		{
+			double lane_zr[8], lane_zi[8], lane_cr[8], lane_ci[8];
+			_mm512_storeu_pd(lane_zr, escaped_r);
+			_mm512_storeu_pd(lane_zi, escaped_i);
+			_mm512_storeu_pd(lane_cr, cr);
+			_mm512_storeu_pd(lane_ci, ci);
+			smooth_lanes<Order>(lanes, lane_zr, lane_zi, lane_cr, lane_ci, (count - n < 8) ? count - n : 8,
+								iter_max, smooth + n);
+		}
+	}
+}
+
+/***************************************************************
+
+						SINGLE PRECISION
+
+	Twice the lanes of the double loops. c is still worked out in
+	double and rounded, so the pixels land where the double path
+	puts them, and the counts are kept as integers so iter_max
+	isn't limited by the float mantissa. There's no periodicity
+	check, only the cardioid test. The fractional counts are taken
+	from the escaped float z like escape_pixel_float does.
+
+****************************************************************/
+
+template <int Order>
+SIMD_TARGET_AVX2 static inline void avx2_step_ps(__m256 &zr, __m256 &zi, __m256 cr, __m256 ci)
+{
+	if (2 == Order)
+	{
+		__m256 zr2 = _mm256_mul_ps(zr, zr);
+		__m256 zi2 = _mm256_mul_ps(zi, zi);
+		zi = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), zr), zi), ci);
+		zr = _mm256_add_ps(_mm256_sub_ps(zr2, zi2), cr);
+	}
+	else
+	{
+		__m256 wr = _mm256_sub_ps(_mm256_mul_ps(zr, zr), _mm256_mul_ps(zi, zi));
+		__m256 wi = _mm256_add_ps(_mm256_mul_ps(zr, zi), _mm256_mul_ps(zi, zr));
+		__m256 tr = _mm256_sub_ps(_mm256_mul_ps(wr, zr), _mm256_mul_ps(wi, zi));
+		__m256 ti = _mm256_add_ps(_mm256_mul_ps(wr, zi), _mm256_mul_ps(wi, zr));
+		zr = _mm256_add_ps(tr, cr);
+		zi = _mm256_add_ps(ti, ci);
+	}
+}
+
+//Eight coordinates origin + (first + lane) * step (or origin - ... for Column) rounded to float
+template <bool Column>
+SIMD_TARGET_AVX2 static inline __m256 avx2_line_coords_ps(double origin, double step, int first)
+{
+	const __m256d lane_offsets = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+	__m256d lo = _mm256_add_pd(_mm256_set1_pd((double)first), lane_offsets);
+	__m256d hi = _mm256_add_pd(_mm256_set1_pd((double)(first + 4)), lane_offsets);
+	if (Column)
+	{
+		lo = _mm256_sub_pd(_mm256_set1_pd(origin), _mm256_mul_pd(lo, _mm256_set1_pd(step)));
+		hi = _mm256_sub_pd(_mm256_set1_pd(origin), _mm256_mul_pd(hi, _mm256_set1_pd(step)));
+	}
+	else
+	{
+		lo = _mm256_add_pd(_mm256_set1_pd(origin), _mm256_mul_pd(lo, _mm256_set1_pd(step)));
+		hi = _mm256_add_pd(_mm256_set1_pd(origin), _mm256_mul_pd(hi, _mm256_set1_pd(step)));
+	}
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+}
+
+template <int Order, bool Column, bool Smooth, typename CountT>
+SIMD_TARGET_AVX2 static void avx2_escape_line_ps(double origin, double step, int first, double fixed,
+												 int count, int iter_max, bool cardioid, CountT *out,
+												 float *smooth, interior_stats &stats)
+{
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	for (int n = 0; n < count; n += 8)
+	{
+		__m256 line = avx2_line_coords_ps<Column>(origin, step, first + n);
+		__m256 cr = Column ? _mm256_set1_ps((float)fixed) : line;
+		__m256 ci = Column ? line : _mm256_set1_ps((float)fixed);
+		__m256 zr = cr;
+		__m256 zi = ci;
+		__m256i iters = _mm256_setzero_si256();
+		__m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256 resolved = _mm256_setzero_ps();
+		int valid_lanes = (count - n < 8) ? (1 << (count - n)) - 1 : 0xFF;
+
+		if (cardioid)
+		{
+			__m256 xq = _mm256_sub_ps(cr, _mm256_set1_ps(0.25f));
+			__m256 ci2 = _mm256_mul_ps(ci, ci);
+			__m256 q = _mm256_add_ps(_mm256_mul_ps(xq, xq), ci2);
+			__m256 in_cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xq)),
+											   _mm256_mul_ps(_mm256_set1_ps(0.25f), ci2), _CMP_LE_OQ);
+			__m256 xb = _mm256_add_ps(cr, one);
+			__m256 in_bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(xb, xb), ci2),
+										   _mm256_set1_ps(0.0625f), _CMP_LE_OQ);
+			resolved = _mm256_or_ps(in_cardioid, in_bulb);
+			active = _mm256_andnot_ps(resolved, active);
+			stats.cardioid += count_set_lanes(_mm256_movemask_ps(resolved) & valid_lanes);
+		}
+
+		__m256 escaped_r = zr;
+		__m256 escaped_i = zi;
+
+		for (int iter = 0; iter < iter_max; ++iter)
+		{
+			__m256 mag = _mm256_add_ps(_mm256_mul_ps(zr, zr), _mm256_mul_ps(zi, zi));
+			__m256 inside = _mm256_and_ps(active, _mm256_cmp_ps(mag, four, _CMP_LT_OQ));
+			if (Smooth)
+			{
+				__m256 leaving = _mm256_andnot_ps(inside, active);
+				escaped_r = _mm256_blendv_ps(escaped_r, zr, leaving);
+				escaped_i = _mm256_blendv_ps(escaped_i, zi, leaving);
+			}
+			active = inside;
+			if (0 == _mm256_movemask_ps(active))
+			{
+				break;
+			}
+			//Active lanes are all ones, i.e. -1
+			iters = _mm256_sub_epi32(iters, _mm256_castps_si256(active));
+			avx2_step_ps<Order>(zr, zi, cr, ci);
+		}
+
+		iters = _mm256_blendv_epi8(iters, _mm256_set1_epi32(iter_max), _mm256_castps_si256(resolved));
+
+		int lanes[8];
+		_mm256_storeu_si256((__m256i*)lanes, iters);
+		for (int l = 0; l < 8 && n + l < count; ++l)
+		{
+			out[n + l] = (CountT)lanes[l];
+		}
+
+		if (Smooth)
+		{
+			float lane_zr[8], lane_zi[8], lane_cr[8], lane_ci[8];
+			_mm256_storeu_ps(lane_zr, escaped_r);
+			_mm256_storeu_ps(lane_zi, escaped_i);
+			_mm256_storeu_ps(lane_cr, cr);
+			_mm256_storeu_ps(lane_ci, ci);
+			smooth_lanes<Order>(lanes, lane_zr, lane_zi, lane_cr, lane_ci, (count - n < 8) ? count - n : 8,
+								iter_max, smooth + n);
+		}
+	}
+}
+
+template <int Order>
+SIMD_TARGET_AVX512 static inline void avx512_step_ps(__m512 &zr, __m512 &zi, __m512 cr, __m512 ci)
+{
+	if (2 == Order)
+	{
+		__m512 zr2 = _mm512_mul_ps(zr, zr);
+		__m512 zi2 = _mm512_mul_ps(zi, zi);
+		zi = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(2.0f), zr), zi), ci);
+		zr = _mm512_add_ps(_mm512_sub_ps(zr2, zi2), cr);
+	}
+	else
+	{
+		__m512 wr = _mm512_sub_ps(_mm512_mul_ps(zr, zr), _mm512_mul_ps(zi, zi));
+		__m512 wi = _mm512_add_ps(_mm512_mul_ps(zr, zi), _mm512_mul_ps(zi, zr));
+		__m512 tr = _mm512_sub_ps(_mm512_mul_ps(wr, zr), _mm512_mul_ps(wi, zi));
+		__m512 ti = _mm512_add_ps(_mm512_mul_ps(wr, zi), _mm512_mul_ps(wi, zr));
+		zr = _mm512_add_ps(tr, cr);
+		zi = _mm512_add_ps(ti, ci);
+	}
+}
+
+template <bool Column>
+SIMD_TARGET_AVX512 static inline __m512 avx512_line_coords_ps(double origin, double step, int first)
+{
+	const __m512d lane_offsets = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+	__m512d lo = _mm512_add_pd(_mm512_set1_pd((double)first), lane_offsets);
+	__m512d hi = _mm512_add_pd(_mm512_set1_pd((double)(first + 8)), lane_offsets);
+	if (Column)
+	{
+		lo = _mm512_sub_pd(_mm512_set1_pd(origin), _mm512_mul_pd(lo, _mm512_set1_pd(step)));
+		hi = _mm512_sub_pd(_mm512_set1_pd(origin), _mm512_mul_pd(hi, _mm512_set1_pd(step)));
+	}
+	else
+	{
+		lo = _mm512_add_pd(_mm512_set1_pd(origin), _mm512_mul_pd(lo, _mm512_set1_pd(step)));
+		hi = _mm512_add_pd(_mm512_set1_pd(origin), _mm512_mul_pd(hi, _mm512_set1_pd(step)));
+	}
+	//Glued together through the double view, _mm512_insertf32x8 would need AVX512DQ
+	__m512d joined = _mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(_mm512_cvtpd_ps(lo))),
+										_mm256_castps_pd(_mm512_cvtpd_ps(hi)), 1);
+	return _mm512_castpd_ps(joined);
+}
+
+template <int Order, bool Column, bool Smooth, typename CountT>
+SIMD_TARGET_AVX512 static void avx512_escape_line_ps(double origin, double step, int first, double fixed,
+													 int count, int iter_max, bool cardioid, CountT *out,
+													 float *smooth, interior_stats &stats)
+{
+	const __m512 four = _mm512_set1_ps(4.0f);
+	const __m512 one = _mm512_set1_ps(1.0f);
+
+	for (int n = 0; n < count; n += 16)
+	{
+		__m512 line = avx512_line_coords_ps<Column>(origin, step, first + n);
+		__m512 cr = Column ? _mm512_set1_ps((float)fixed) : line;
+		__m512 ci = Column ? line : _mm512_set1_ps((float)fixed);
+		__m512 zr = cr;
+		__m512 zi = ci;
+		__m512i iters = _mm512_setzero_si512();
+		__mmask16 active = 0xFFFF;
+		__mmask16 resolved = 0;
+		__mmask16 valid_lanes = (count - n < 16) ? (__mmask16)((1 << (count - n)) - 1) : (__mmask16)0xFFFF;
+
+		if (cardioid)
+		{
+			__m512 xq = _mm512_sub_ps(cr, _mm512_set1_ps(0.25f));
+			__m512 ci2 = _mm512_mul_ps(ci, ci);
+			__m512 q = _mm512_add_ps(_mm512_mul_ps(xq, xq), ci2);
+			__mmask16 in_cardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xq)),
+													   _mm512_mul_ps(_mm512_set1_ps(0.25f), ci2), _CMP_LE_OQ);
+			__m512 xb = _mm512_add_ps(cr, one);
+			__mmask16 in_bulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(xb, xb), ci2),
+												   _mm512_set1_ps(0.0625f), _CMP_LE_OQ);
+			resolved = in_cardioid | in_bulb;
+			active &= (__mmask16)~resolved;
+			stats.cardioid += count_set_lanes(resolved & valid_lanes);
+		}
+
+		__m512 escaped_r = zr;
+		__m512 escaped_i = zi;
+
+		for (int iter = 0; iter < iter_max; ++iter)
+		{
+			__m512 mag = _mm512_add_ps(_mm512_mul_ps(zr, zr), _mm512_mul_ps(zi, zi));
+			__mmask16 inside = _mm512_mask_cmp_ps_mask(active, mag, four, _CMP_LT_OQ);
+			if (Smooth)
+			{
+				__mmask16 leaving = active & (__mmask16)~inside;
+				escaped_r = _mm512_mask_mov_ps(escaped_r, leaving, zr);
+				escaped_i = _mm512_mask_mov_ps(escaped_i, leaving, zi);
+			}
+			active = inside;
+			if (0 == active)
+			{
+				break;
+			}
+			iters = _mm512_mask_add_epi32(iters, active, iters, _mm512_set1_epi32(1));
+			avx512_step_ps<Order>(zr, zi, cr, ci);
+		}
+
+		iters = _mm512_mask_mov_epi32(iters, resolved, _mm512_set1_epi32(iter_max));
+
+		int lanes[16];
+		_mm512_storeu_si512((void*)lanes, iters);
+		for (int l = 0; l < 16 && n + l < count; ++l)
+		{
+			out[n + l] = (CountT)lanes[l];
+		}
+
+		if (Smooth)
+		{
+			float lane_zr[16], lane_zi[16], lane_cr[16], lane_ci[16];
+			_mm512_storeu_ps(lane_zr, escaped_r);
+			_mm512_storeu_ps(lane_zi, escaped_i);
+			_mm512_storeu_ps(lane_cr, cr);
+			_mm512_storeu_ps(lane_ci, ci);
+			smooth_lanes<Order>(lanes, lane_zr, lane_zi, lane_cr, lane_ci, (count - n < 16) ? count - n : 16,
+								iter_max, smooth + n);
+		}
+	}
+}
+
+/***************************************************************
+
+						PALETTE LOOKUP
+
+****************************************************************/
+
+//Eight counts widened to 32 bits
+SIMD_TARGET_AVX2 static inline __m256i load_counts(const uint16_t *counts)
+{
+	return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)counts));
+}
+
+SIMD_TARGET_AVX2 static inline __m256i load_counts(const uint32_t *counts)
+{
+	return _mm256_loadu_si256((const __m256i*)counts);
+}
+
+SIMD_TARGET_AVX2 static inline __m256i load_counts(const int *counts)
+{
+	return _mm256_loadu_si256((const __m256i*)counts);
+}
+
+//Drops the unused top byte of eight packed palette entries and stores the 24 bytes
+//of BGR. Each half is written with a 16 byte store, so 4 bytes past the end get
+//overwritten as well.
+SIMD_TARGET_AVX2 static inline void store_bgr(__m256i pixels, unsigned char *bgr)
+{
+	const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+										  0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	__m256i packed = _mm256_shuffle_epi8(pixels, pack);
+	_mm_storeu_si128((__m128i*)bgr, _mm256_castsi256_si128(packed));
+	_mm_storeu_si128((__m128i*)(bgr + 12), _mm256_extracti128_si256(packed, 1));
+}
+
+template <typename CountT>
+SIMD_TARGET_AVX2 static int avx2_colour_span(const CountT *counts, int count, const uint32_t *palette,
+											 int max_index, unsigned char *bgr)
+{
+	const __m256i last = _mm256_set1_epi32(max_index);
+	int x = 0;
+
+	//Stop while there are still two pixels left for store_bgr to spill into
+	for (; x + 10 <= count; x += 8)
+	{
+		__m256i index = _mm256_min_epu32(load_counts(counts + x), last);
+		store_bgr(_mm256_i32gather_epi32((const int*)palette, index, 4), bgr + 3 * x);
+	}
+	return x;
+}
+
+//Index is smooth * scale + 0.5 clamped to [0, max_index] and truncated, in double
+//precision so it picks the same entry as the scalar loop
+SIMD_TARGET_AVX2 static int avx2_colour_smooth_span(const float *smooth, int count, double scale,
+													const uint32_t *palette, int max_index, unsigned char *bgr)
+{
+	const __m256d scale_v = _mm256_set1_pd(scale);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d last = _mm256_set1_pd((double)max_index);
+	int x = 0;
+
+	for (; x + 10 <= count; x += 8)
+	{
+		__m256d lo = _mm256_cvtps_pd(_mm_loadu_ps(smooth + x));
+		__m256d hi = _mm256_cvtps_pd(_mm_loadu_ps(smooth + x + 4));
+		lo = _mm256_min_pd(_mm256_max_pd(_mm256_add_pd(_mm256_mul_pd(lo, scale_v), half), zero), last);
+		hi = _mm256_min_pd(_mm256_max_pd(_mm256_add_pd(_mm256_mul_pd(hi, scale_v), half), zero), last);
+
+		__m256i index = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(lo)),
+												_mm256_cvttpd_epi32(hi), 1);
+		store_bgr(_mm256_i32gather_epi32((const int*)palette, index, 4), bgr + 3 * x);
+	}
+	return x;
+}
+
+#endif
+
+#if defined(MANDEL_SIMD_X86)
+//Periodic / Smooth instantiation of the AVX2 loop for the checks and outputs asked for
+template <int Order, bool Column, typename CountT>
+static void avx2_escape_line_for(bool periodic, double origin, double step, int first, double fixed, int count,
+								 int iter_max, bool cardioid, CountT *out, float *smooth, double *final_z,
+								 interior_stats &stats)
+{
+	if (periodic && NULL != smooth)
+		avx2_escape_line<Order, true, Column, true>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else if (periodic)
+		avx2_escape_line<Order, true, Column, false>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else if (NULL != smooth)
+		avx2_escape_line<Order, false, Column, true>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else
+		avx2_escape_line<Order, false, Column, false>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+}
+
+template <int Order, bool Column, typename CountT>
+static void avx512_escape_line_for(bool periodic, double origin, double step, int first, double fixed, int count,
+								   int iter_max, bool cardioid, CountT *out, float *smooth, double *final_z,
+								   interior_stats &stats)
+{
+	if (periodic && NULL != smooth)
+		avx512_escape_line<Order, true, Column, true>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else if (periodic)
+		avx512_escape_line<Order, true, Column, false>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else if (NULL != smooth)
+		avx512_escape_line<Order, false, Column, true>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else
+		avx512_escape_line<Order, false, Column, false>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+}
+#endif
+
+//Picks the instantiation for the level/order/checks, false if there isn't one
+template <bool Column, typename CountT>
+static bool simd_escape_line(simd_level level, int order, double origin, double step, int first,
+							 double fixed, int count, int iter_max, int interior_checks,
+							 CountT *out, interior_stats &stats, float *smooth, double *final_z)
+{
+#if defined(MANDEL_SIMD_X86)
+	bool cardioid = (2 == order) && (0 != (interior_checks & INTERIOR_CARDIOID));
+	bool periodic = (0 != (interior_checks & INTERIOR_PERIODICITY));
+
+	if (SIMD_AVX512 == level && 2 == order)
+		avx512_escape_line_for<2, Column>(periodic, origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else if (SIMD_AVX512 == level && 3 == order)
+		avx512_escape_line_for<3, Column>(periodic, origin, step, first, fixed, count, iter_max, false, out, smooth, final_z, stats);
+	else if (SIMD_AVX2 == level && 2 == order)
+		avx2_escape_line_for<2, Column>(periodic, origin, step, first, fixed, count, iter_max, cardioid, out, smooth, final_z, stats);
+	else if (SIMD_AVX2 == level && 3 == order)
+		avx2_escape_line_for<3, Column>(periodic, origin, step, first, fixed, count, iter_max, false, out, smooth, final_z, stats);
+	else
+		return false;
+	return true;
+#else
+	return false;
+#endif
+}
+
+//Single precision version of simd_escape_line, periodicity checking isn't available
+template <bool Column, typename CountT>
+static bool simd_escape_line_float(simd_level level, int order, double origin, double step, int first,
+								   double fixed, int count, int iter_max, int interior_checks,
+								   CountT *out, interior_stats &stats, float *smooth)
+{
+#if defined(MANDEL_SIMD_X86)
+	bool cardioid = (2 == order) && (0 != (interior_checks & INTERIOR_CARDIOID));
+	bool smoothed = (NULL != smooth);
+
+	if (SIMD_AVX512 == level && 2 == order && smoothed)
+		avx512_escape_line_ps<2, Column, true>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, stats);
+	else if (SIMD_AVX512 == level && 2 == order)
+		avx512_escape_line_ps<2, Column, false>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, stats);
+	else if (SIMD_AVX512 == level && 3 == order && smoothed)
+		avx512_escape_line_ps<3, Column, true>(origin, step, first, fixed, count, iter_max, false, out, smooth, stats);
+	else if (SIMD_AVX512 == level && 3 == order)
+		avx512_escape_line_ps<3, Column, false>(origin, step, first, fixed, count, iter_max, false, out, smooth, stats);
+	else if (SIMD_AVX2 == level && 2 == order && smoothed)
+		avx2_escape_line_ps<2, Column, true>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, stats);
+	else if (SIMD_AVX2 == level && 2 == order)
+		avx2_escape_line_ps<2, Column, false>(origin, step, first, fixed, count, iter_max, cardioid, out, smooth, stats);
+	else if (SIMD_AVX2 == level && 3 == order && smoothed)
+		avx2_escape_line_ps<3, Column, true>(origin, step, first, fixed, count, iter_max, false, out, smooth, stats);
+	else if (SIMD_AVX2 == level && 3 == order)
+		avx2_escape_line_ps<3, Column, false>(origin, step, first, fixed, count, iter_max, false, out, smooth, stats);
+	else
+		return false;
+	return true;
+#else
+	return false;
+#endif
+}
+
+template <typename CountT>
+bool simd_escape_span(simd_level level, int order, double cr_min, double cr_step, int first_x,
+					  double ci, int count, int iter_max, int interior_checks,
+					  CountT *out, interior_stats &stats, float *smooth, double *final_z)
+{
+	return simd_escape_line<false>(level, order, cr_min, cr_step, first_x, ci, count, iter_max,
+								   interior_checks, out, stats, smooth, final_z);
+}
+
+template <typename CountT>
+bool simd_escape_column(simd_level level, int order, double cr, double ci_max, double ci_step, int first_y,
+						int count, int iter_max, int interior_checks, CountT *out, interior_stats &stats,
+						float *smooth)
+{
+	return simd_escape_line<true>(level, order, ci_max, ci_step, first_y, cr, count, iter_max,
+								  interior_checks, out, stats, smooth, NULL);
+}
+
+template <typename CountT>
+bool simd_escape_span_float(simd_level level, int order, double cr_min, double cr_step, int first_x,
+							double ci, int count, int iter_max, int interior_checks,
+							CountT *out, interior_stats &stats, float *smooth)
+{
+	return simd_escape_line_float<false>(level, order, cr_min, cr_step, first_x, ci, count, iter_max,
+										 interior_checks, out, stats, smooth);
+}
+
+template <typename CountT>
+bool simd_escape_column_float(simd_level level, int order, double cr, double ci_max, double ci_step, int first_y,
+							  int count, int iter_max, int interior_checks, CountT *out, interior_stats &stats,
+							  float *smooth)
+{
+	return simd_escape_line_float<true>(level, order, ci_max, ci_step, first_y, cr, count, iter_max,
+										interior_checks, out, stats, smooth);
+}
+
+template <typename CountT>
+int simd_colour_span(simd_level level, const CountT *counts, int count, const uint32_t *palette, int max_index,
+					 unsigned char *bgr)
+{
+#if defined(MANDEL_SIMD_X86)
+	//The gather is AVX2, there's nothing to gain from the wider registers here
+	if (SIMD_SCALAR != level)
+	{
+		return avx2_colour_span(counts, count, palette, max_index, bgr);
+	}
+#endif
+	return 0;
+}
+
+int simd_colour_smooth_span(simd_level level, const float *smooth, int count, double scale, const uint32_t *palette,
+							int max_index, unsigned char *bgr)
+{
+#if defined(MANDEL_SIMD_X86)
+	if (SIMD_SCALAR != level)
+	{
+		return avx2_colour_smooth_span(smooth, count, scale, palette, max_index, bgr);
+	}
+#endif
+	return 0;
+}
+
+//The count types the plotter can render into
+template bool simd_escape_span<int>(simd_level, int, double, double, int, double, int, int, int, int*, interior_stats&, float*, double*);
+template bool simd_escape_span<uint16_t>(simd_level, int, double, double, int, double, int, int, int, uint16_t*, interior_stats&, float*, double*);
+template bool simd_escape_span<uint32_t>(simd_level, int, double, double, int, double, int, int, int, uint32_t*, interior_stats&, float*, double*);
+template bool simd_escape_column<int>(simd_level, int, double, double, double, int, int, int, int, int*, interior_stats&, float*);
+template bool simd_escape_column<uint16_t>(simd_level, int, double, double, double, int, int, int, int, uint16_t*, interior_stats&, float*);
+template bool simd_escape_column<uint32_t>(simd_level, int, double, double, double, int, int, int, int, uint32_t*, interior_stats&, float*);
+template bool simd_escape_span_float<int>(simd_level, int, double, double, int, double, int, int, int, int*, interior_stats&, float*);
+template bool simd_escape_span_float<uint16_t>(simd_level, int, double, double, int, double, int, int, int, uint16_t*, interior_stats&, float*);
+template bool simd_escape_span_float<uint32_t>(simd_level, int, double, double, int, double, int, int, int, uint32_t*, interior_stats&, float*);
+template bool simd_escape_column_float<int>(simd_level, int, double, double, double, int, int, int, int, int*, interior_stats&, float*);
+template bool simd_escape_column_float<uint16_t>(simd_level, int, double, double, double, int, int, int, int, uint16_t*, interior_stats&, float*);
+template bool simd_escape_column_float<uint32_t>(simd_level, int, double, double, double, int, int, int, int, uint32_t*, interior_stats&, float*);
+template int simd_colour_span<int>(simd_level, const int*, int, const uint32_t*, int, unsigned char*);
+template int simd_colour_span<uint16_t>(simd_level, const uint16_t*, int, const uint32_t*, int, unsigned char*);
+template int simd_colour_span<uint32_t>(simd_level, const uint32_t*, int, const uint32_t*, int, unsigned char*);
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef _MANDEL_SIMD_HPP
+#define _MANDEL_SIMD_HPP
+
+/***************************************************************
+
+					SIMD ESCAPE TIME
+
+	Vectorised escape time for a horizontal span of pixels. Each
+	lane holds one pixel, escaped lanes are masked off and keep
+	their count while the rest of the vector carries on iterating.
+	The arithmetic is done in the same order as the scalar kernels
+	so the counts match the scalar path exactly. The loops can also
+	keep each lane's z at its escape for the fractional counts.
+
+	There is a single precision copy of the loops for shallow zooms,
+	which doesn't match the double counts but does twice as many
+	pixels per vector.
+
+	Also the palette lookup used to colour the counts, eight
+	pixels at a time with a gather from a packed palette.
+
+****************************************************************/
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mandel_kernels.hpp"
+
+enum simd_level
+{
+	SIMD_SCALAR = 0,	//No vector unit available, plain C++ loop
+	SIMD_AVX2 = 1,		//4 doubles per vector
+	SIMD_AVX512 = 2		//8 doubles per vector
+};
+
+//Checks the CPU (and OS support for the wider registers) at runtime
+simd_level detect_simd_level(void);
+
+//Readable name for logging
+const char* simd_level_name(simd_level level);
+
+//Number of pixels processed per vector at the given level
+int simd_lane_count(simd_level level);
+
+//Computes the escape time of count pixels along a row, where pixel n is at
+//c = (cr_min + (first_x + n) * cr_step) + ci*i. Only orders 2 and 3 are vectorised,
+//returns false without touching out if the order/level can't be handled.
+//interior_checks takes the interior_check flags, the cardioid test is only
+//applied for order 2. The pixels resolved by each check are added to stats.
+//CountT is int, uint16_t or uint32_t, to match the plotter's count buffer.
+//If smooth isn't NULL it gets the fractional count of each pixel as well, the
+//same values smooth_iteration_count gives on the scalar path. If final_z isn't
+//NULL it gets 2 * count doubles, z of each pixel where the loop stopped as re/im
+//pairs (NaN for pixels an interior check resolved), see escape_time_from.
+template <typename CountT>
+bool simd_escape_span(simd_level level, int order, double cr_min, double cr_step, int first_x,
+					  double ci, int count, int iter_max, int interior_checks,
+					  CountT *out, interior_stats &stats, float *smooth = NULL, double *final_z = NULL);
+
+//Same as simd_escape_span but down a column, pixel n is at
+//c = cr + (ci_max - (first_y + n) * ci_step)*i
+template <typename CountT>
+bool simd_escape_column(simd_level level, int order, double cr, double ci_max, double ci_step, int first_y,
+						int count, int iter_max, int interior_checks, CountT *out, interior_stats &stats,
+						float *smooth = NULL);
+
+//Single precision versions for shallow zooms, twice the pixels per vector. c is
+//computed in double as above and rounded to float. The cardioid test is honoured,
+//periodicity checking isn't (the counts are the same without it, only slower).
+template <typename CountT>
+bool simd_escape_span_float(simd_level level, int order, double cr_min, double cr_step, int first_x,
+							double ci, int count, int iter_max, int interior_checks,
+							CountT *out, interior_stats &stats, float *smooth = NULL);
+
+template <typename CountT>
+bool simd_escape_column_float(simd_level level, int order, double cr, double ci_max, double ci_step, int first_y,
+							  int count, int iter_max, int interior_checks, CountT *out, interior_stats &stats,
+							  float *smooth = NULL);
+
+//Colours pixels from count palette entries of 0x00RRGGBB, palette[min(counts[n], max_index)]
+//goes to bgr[3n..3n+2] in bitmap order. Returns how many pixels it did (always leaving
+//at least two), the caller finishes the rest. 0 if the level has no vector loop.
+template <typename CountT>
+int simd_colour_span(simd_level level, const CountT *counts, int count, const uint32_t *palette, int max_index,
+					 unsigned char *bgr);
+
+//Same for smooth counts, the entry is (int)(smooth[n] * scale + 0.5) clamped to [0, max_index]
+int simd_colour_smooth_span(simd_level level, const float *smooth, int count, double scale, const uint32_t *palette,
+							int max_index, unsigned char *bgr);
+
+#endif
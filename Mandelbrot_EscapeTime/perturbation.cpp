@@ -0,0 +1,161 @@
+/*
+	High precision reference orbits for the perturbation renderer.
+*/
+
+#include "perturbation.hpp"
+
+#include <cmath>
+
+using namespace std;
+
+reference_orbit::reference_orbit()
+	: m_series_length(0)
+{
+}
+
+void reference_orbit::compute(const fixed_point &real, const fixed_point &imaginary, int iter_max)
+{
+	m_real = real;
+	m_imaginary = imaginary;
+	m_orbit_real.clear();
+	m_orbit_imaginary.clear();
+	m_glitch_bound.clear();
+	m_series.clear();
+	m_series_length = 0;
+
+	fixed_point zr = real;
+	fixed_point zi = imaginary;
+	for (int iter = 0; ; iter++)
+	{
+		double r = zr.to_double();
+		double i = zi.to_double();
+		double modulus = r * r + i * i;
+		m_orbit_real.push_back(r);
+		m_orbit_imaginary.push_back(i);
+		m_glitch_bound.push_back(PERTURB_GLITCH_TOLERANCE * modulus);
+
+		//Past the bailout nothing more is needed, |Z| < 2 also keeps the fixed
+		//point products well inside the integer limb
+		if (modulus >= 4.0 || iter >= iter_max)
+		{
+			break;
+		}
+
+		fixed_point zr2 = zr * zr;
+		fixed_point zi2 = zi * zi;
+		zi = (zr * zi).twice() + imaginary;
+		zr = zr2 - zi2 + real;
+	}
+}
+
+const fixed_point& reference_orbit::get_real(void) const
+{
+	return m_real;
+}
+
+const fixed_point& reference_orbit::get_imaginary(void) const
+{
+	return m_imaginary;
+}
+
+int reference_orbit::length(void) const
+{
+	return (int)m_orbit_real.size();
+}
+
+void reference_orbit::compute_series(double radius)
+{
+	//z_0 = c, so dz_0 = dc exactly, A_0 = 1 and the rest start at zero
+	double ar = 1.0, ai = 0.0;
+	double br = 0.0, bi = 0.0;
+	double cr = 0.0, ci = 0.0;
+	double radius2 = radius * radius;
+
+	m_series.clear();
+	m_series_length = 0;
+	for (int n = 0; n < length(); n++)
+	{
+		double a = sqrt(ar * ar + ai * ai);
+		double b = sqrt(br * br + bi * bi);
+		double c = sqrt(cr * cr + ci * ci);
+		if (!std::isfinite(a) || !std::isfinite(b) || !std::isfinite(c) ||
+			b * radius > SERIES_DIVERGENCE * a || c * radius2 > SERIES_DIVERGENCE * a)
+		{
+			break;
+		}
+
+		m_series.push_back(ar);
+		m_series.push_back(ai);
+		m_series.push_back(br);
+		m_series.push_back(bi);
+		m_series.push_back(cr);
+		m_series.push_back(ci);
+		m_series_length = n + 1;
+
+		//A' = 2ZA + 1, B' = 2ZB + A^2, C' = 2ZC + 2AB
+		double zr2 = 2.0 * m_orbit_real[n];
+		double zi2 = 2.0 * m_orbit_imaginary[n];
+		double next_cr = zr2 * cr - zi2 * ci + 2.0 * (ar * br - ai * bi);
+		double next_ci = zr2 * ci + zi2 * cr + 2.0 * (ar * bi + ai * br);
+		double next_br = zr2 * br - zi2 * bi + ar * ar - ai * ai;
+		double next_bi = zr2 * bi + zi2 * br + 2.0 * ar * ai;
+		double next_ar = zr2 * ar - zi2 * ai + 1.0;
+		double next_ai = zr2 * ai + zi2 * ar;
+		ar = next_ar;
+		ai = next_ai;
+		br = next_br;
+		bi = next_bi;
+		cr = next_cr;
+		ci = next_ci;
+	}
+}
+
+int reference_orbit::series_length(void) const
+{
+	return m_series_length;
+}
+
+int reference_orbit::series_skip(const double *probe_r, const double *probe_i, int num_probes, int iter_max) const
+{
+	int skip = (m_series_length - 1 < iter_max) ? m_series_length - 1 : iter_max;
+	const double tolerance2 = SERIES_TOLERANCE * SERIES_TOLERANCE;
+
+	for (int p = 0; p < num_probes && 0 < skip; p++)
+	{
+		double dcr = probe_r[p];
+		double dci = probe_i[p];
+		double dzr = dcr;
+		double dzi = dci;
+		int valid = 0;
+
+		for (int n = 0; n <= skip; n++)
+		{
+			double sr, si;
+			series_offset(n, dcr, dci, sr, si);
+			double er = sr - dzr;
+			double ei = si - dzi;
+			if (er * er + ei * ei > tolerance2 * (dzr * dzr + dzi * dzi))
+			{
+				break;
+			}
+			valid = n;
+
+			//Starting any later would step over the probe escaping or glitching
+			double zr = m_orbit_real[n] + dzr;
+			double zi = m_orbit_imaginary[n] + dzi;
+			double modulus = zr * zr + zi * zi;
+			if (modulus >= 4.0 || modulus < m_glitch_bound[n])
+			{
+				break;
+			}
+
+			double tr = 2.0 * m_orbit_real[n] + dzr;
+			double ti = 2.0 * m_orbit_imaginary[n] + dzi;
+			double nr = tr * dzr - ti * dzi + dcr;
+			dzi = tr * dzi + ti * dzr + dci;
+			dzr = nr;
+		}
+		skip = valid;
+	}
+	return (0 < skip) ? skip : 0;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#ifndef _PERTURBATION_HPP
+#define _PERTURBATION_HPP
+
+#include <vector>
+
+#include "fixed_point.hpp"
+
+/***************************************************************
+
+						PERTURBATION
+
+	Deep zoom rendering for z^2 + c. Past a zoom of about 1e-13
+	neighbouring pixels are no longer distinct doubles, so a single
+	reference orbit Z_n is computed in fixed point at C and every
+	other pixel c = C + dc is iterated as its offset from it,
+
+		z_n = Z_n + dz_n,  dz_(n+1) = 2 Z_n dz_n + dz_n^2 + dc
+
+	which only ever involves small numbers and so stays in doubles.
+
+	The offset loses all of its precision when z_n passes close to
+	zero while Z_n doesn't (Pauldelbrot's criterion), or when the
+	reference escapes before the pixel does. Those pixels are
+	reported as glitched and have to be redone against another
+	reference, the plotter picks one among them.
+
+	For the first stretch of the orbit the offsets are still tiny
+	and dz_n is very nearly a polynomial in dc,
+
+		dz_n ~ A_n dc + B_n dc^2 + C_n dc^3
+
+	with coefficients that only depend on the reference. Evaluating
+	it lets a pixel start at iteration N instead of 0 (series
+	approximation). How far is safe is found by iterating a few
+	probe points, normally the corners of the area being drawn, and
+	comparing them with the series.
+
+****************************************************************/
+
+//|z|^2 below this fraction of |Z|^2 marks the pixel as glitched
+#define PERTURB_GLITCH_TOLERANCE 1e-6
+
+//The series is only kept while the dc^2 and dc^3 terms are below this
+//fraction of the linear one over the whole image
+#define SERIES_DIVERGENCE 1e-2
+
+//Relative error of the series against the iterated offset at a probe point
+#define SERIES_TOLERANCE 1e-14
+
+//What the perturbation render had to do, summed over every span
+struct perturbation_stats
+{
+	long long references;	//Orbits computed, including the primary one
+	long long glitched;		//Pixels that needed at least one more reference
+	long long unresolved;	//Still glitched once the reference limit was hit
+	long long skipped;		//Iterations skipped by the series approximation
+};
+
+class reference_orbit
+{
+private:
+
+	fixed_point m_real;
+	fixed_point m_imaginary;
+
+	//Z_0 = C up to the iteration it escaped at, or Z_(iter_max) if it didn't
+	std::vector<double> m_orbit_real;
+	std::vector<double> m_orbit_imaginary;
+
+	//PERTURB_GLITCH_TOLERANCE * |Z_n|^2
+	std::vector<double> m_glitch_bound;
+
+	//A_n, B_n and C_n as re/im pairs, six doubles per iteration
+	std::vector<double> m_series;
+	int m_series_length;
+
+public:
+
+	reference_orbit();
+
+	//Iterates C = real + i imaginary in fixed point at their precision, this drops
+	//any series computed for the previous orbit
+	void compute(const fixed_point &real, const fixed_point &imaginary, int iter_max);
+
+	//Series coefficients for offsets up to radius, as far as they stay usable
+	void compute_series(double radius);
+
+	//Number of iterations the series has coefficients for
+	int series_length(void) const;
+
+	// Furthest iteration all of the probe offsets can start from, the series has to
+	// match the iterated offset there and none of them can have escaped or glitched
+	// before it. Anything inside the probes is assumed to behave as well.
+	int series_skip(const double *probe_r, const double *probe_i, int num_probes, int iter_max) const;
+
+	// dz_n from the series, n < series_length()
+	inline void series_offset(int n, double dcr, double dci, double &dzr, double &dzi) const
+	{
+		const double *coeff = &m_series[6 * (size_t)n];
+		double dc2r = dcr * dcr - dci * dci;
+		double dc2i = 2.0 * dcr * dci;
+		double dc3r = dc2r * dcr - dc2i * dci;
+		double dc3i = dc2r * dci + dc2i * dcr;
+		dzr = coeff[0] * dcr - coeff[1] * dci + coeff[2] * dc2r - coeff[3] * dc2i + coeff[4] * dc3r - coeff[5] * dc3i;
+		dzi = coeff[0] * dci + coeff[1] * dcr + coeff[2] * dc2i + coeff[3] * dc2r + coeff[4] * dc3i + coeff[5] * dc3r;
+	}
+
+	const fixed_point& get_real(void) const;
+
+	const fixed_point& get_imaginary(void) const;
+
+	//Number of Z_n stored
+	int length(void) const;
+
+	// Escape count of C + dc, with z the first point outside the bailout so the caller
+	// can work out the smooth count. Matches escape_time, z_0 = c and the count is the
+	// number of iterations done. glitched is set if the result can't be trusted.
+	// skip > 0 starts from the series at that iteration, see series_skip.
+	inline int escape(double dcr, double dci, int iter_max, double &zr, double &zi, bool &glitched,
+					  int skip = 0) const
+	{
+		const double *orbit_r = &m_orbit_real[0];
+		const double *orbit_i = &m_orbit_imaginary[0];
+		const int last = length() - 1;
+		double dzr = dcr;
+		double dzi = dci;
+		int iter = 0;
+
+		if (0 < skip)
+		{
+			series_offset(skip, dcr, dci, dzr, dzi);
+			iter = skip;
+		}
+
+		glitched = false;
+		while (true)
+		{
+			zr = orbit_r[iter] + dzr;
+			zi = orbit_i[iter] + dzi;
+			double modulus = zr * zr + zi * zi;
+			if (modulus >= 4.0 || iter >= iter_max)
+			{
+				return iter;
+			}
+			if (modulus < m_glitch_bound[iter] || iter >= last)
+			{
+				glitched = true;
+				return iter;
+			}
+
+			//dz = (2Z + dz) dz + dc
+			double tr = 2.0 * orbit_r[iter] + dzr;
+			double ti = 2.0 * orbit_i[iter] + dzi;
+			double nr = tr * dzr - ti * dzi + dcr;
+			dzi = tr * dzi + ti * dzr + dci;
+			dzr = nr;
+			iter++;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,439 @@
+/*
+	Command line and config file options for a run, shared between the MPI ranks.
+*/
+
+#include "run_config.hpp"
+#include "image_handler.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#if defined(__unix__)
+#include <mpi.h>
+#endif
+
+using namespace std;
+
+//Band height for --format bmp-bands when --band-rows isn't given
+#define DEFAULT_BAND_ROWS 64
+
+void default_run_config(run_config &config)
+{
+	memset(&config, 0, sizeof(config));
+	config.status = RUN_CONFIG_RENDER;
+
+	config.width = 1920;
+	config.height = 1080;
+	config.max_iter = 500;
+
+	//Zoomed in preset, -2.2 1.2 -1.7 shows the whole set
+	config.min_real = 0.3575;
+	config.max_real = 0.3585;
+	config.min_imaginary = 0.11;
+
+	config.formula = FIRST_ORDER;
+	config.order = 2;
+
+	config.parallel_type = OMP_PARALLEL;
+	config.format = OUTPUT_BMP;
+	config.test_mode = 1;
+}
+
+static bool parse_int(const string &value, int &result)
+{
+	char *end = NULL;
+	errno = 0;
+	long parsed = strtol(value.c_str(), &end, 10);
+	if (value.empty() || '\0' != *end || 0 != errno || parsed < 0 || parsed > 2147483647L)
+	{
+		return false;
+	}
+	result = (int)parsed;
+	return true;
+}
+
+static bool parse_double(const string &value, double &result)
+{
+	char *end = NULL;
+	errno = 0;
+	double parsed = strtod(value.c_str(), &end);
+	if (value.empty() || '\0' != *end || 0 != errno)
+	{
+		return false;
+	}
+	result = parsed;
+	return true;
+}
+
+// Switches are on when given without a value
+static bool parse_switch(const string &value, int &result)
+{
+	if (value.empty() || "1" == value || "true" == value || "yes" == value || "on" == value)
+	{
+		result = 1;
+		return true;
+	}
+	if ("0" == value || "false" == value || "no" == value || "off" == value)
+	{
+		result = 0;
+		return true;
+	}
+	return false;
+}
+
+static bool copy_string(const string &value, char *dest)
+{
+	if (value.size() >= RUN_CONFIG_STRING_LENGTH)
+	{
+		return false;
+	}
+	strcpy(dest, value.c_str());
+	return true;
+}
+
+static bool is_switch(const string &name)
+{
+	return "smooth" == name || "cache" == name || "auto-iterations" == name || "interactive" == name;
+}
+
+// Sets the option called name, printing an error and returning false if the name
+// or value is bad
+static bool apply_option(run_config &config, const string &name, const string &value)
+{
+	bool valid;
+	if ("width" == name)
+	{
+		valid = parse_int(value, config.width);
+	}
+	else if ("height" == name)
+	{
+		valid = parse_int(value, config.height);
+	}
+	else if ("iterations" == name)
+	{
+		valid = parse_int(value, config.max_iter);
+	}
+	else if ("min-real" == name)
+	{
+		valid = parse_double(value, config.min_real);
+	}
+	else if ("max-real" == name)
+	{
+		valid = parse_double(value, config.max_real);
+	}
+	else if ("min-imaginary" == name)
+	{
+		valid = parse_double(value, config.min_imaginary);
+	}
+	else if ("formula" == name)
+	{
+		valid = parse_formula(value, config.formula, config.order);
+	}
+	else if ("parallel" == name)
+	{
+		valid = true;
+		if ("none" == value)
+		{
+			config.parallel_type = NO_PARALLEL;
+		}
+		else if ("omp" == value)
+		{
+			config.parallel_type = OMP_PARALLEL;
+		}
+		else if ("mpi" == value)
+		{
+			config.parallel_type = MPI_PARALLEL;
+		}
+		else if ("both" == value)
+		{
+			config.parallel_type = BOTH_PARALLEL;
+		}
+		else if ("subdivide" == value)
+		{
+			config.parallel_type = SUBDIVIDE_PARALLEL;
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+	else if ("threads" == name)
+	{
+		valid = parse_int(value, config.num_threads);
+	}
+	else if ("tile-size" == name)
+	{
+		valid = parse_int(value, config.tile_size);
+	}
+	else if ("format" == name)
+	{
+		valid = true;
+		if ("bmp" == value)
+		{
+			config.format = OUTPUT_BMP;
+		}
+		else if ("bmp-bands" == value)
+		{
+			config.format = OUTPUT_BMP_BANDS;
+		}
+		else if ("bmp-tiles" == value)
+		{
+			config.format = OUTPUT_BMP_TILES;
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+	else if ("band-rows" == name)
+	{
+		valid = parse_int(value, config.band_rows);
+	}
+	else if ("output" == name)
+	{
+		valid = copy_string(value, config.output);
+	}
+	else if ("smooth" == name)
+	{
+		valid = parse_switch(value, config.smooth);
+	}
+	else if ("cache" == name)
+	{
+		valid = parse_switch(value, config.iteration_cache);
+	}
+	else if ("extend-iterations" == name)
+	{
+		valid = parse_int(value, config.extended_max_iter);
+	}
+	else if ("auto-iterations" == name)
+	{
+		valid = parse_switch(value, config.auto_max_iter);
+	}
+	else if ("antialias" == name)
+	{
+		valid = parse_int(value, config.antialias_grid);
+	}
+	else if ("batch" == name)
+	{
+		valid = copy_string(value, config.batch);
+	}
+	else if ("centre-real" == name)
+	{
+		valid = copy_string(value, config.centre_real);
+	}
+	else if ("centre-imaginary" == name)
+	{
+		valid = copy_string(value, config.centre_imaginary);
+	}
+	else if ("zoom-width" == name)
+	{
+		valid = parse_double(value, config.zoom_width);
+	}
+	else if ("interactive" == name)
+	{
+		valid = parse_switch(value, config.interactive);
+	}
+	else
+	{
+		cout << "Error: unknown option " << name << endl;
+		return false;
+	}
+
+	if (!valid)
+	{
+		cout << "Error: invalid value '" << value << "' for " << name << endl;
+	}
+	return valid;
+}
+
+// Values that parse but can't be rendered
+static bool validate_run_config(run_config &config)
+{
+	bool valid = true;
+	if (config.width < 2 || config.height < 2 || config.max_iter < 1)
+	{
+		cout << "Error: the image needs to be at least 2 x 2 with at least 1 iteration" << endl;
+		valid = false;
+	}
+	//A batch has its own sizes, each view is checked as it's read
+	else if (0 == config.batch[0] && !image_handler::fits_bmp(config.width, config.height))
+	{
+		cout << "Error: a " << config.width << " x " << config.height << " bitmap would be "
+			 << image_handler::bmp_file_size(config.width, config.height) << " bytes, BMP stops at 4 GiB" << endl;
+		valid = false;
+	}
+	if (!(config.max_real > config.min_real))
+	{
+		cout << "Error: max-real has to be above min-real" << endl;
+		valid = false;
+	}
+	if ((0 == config.centre_real[0]) != (0 == config.centre_imaginary[0]) ||
+		(0 != config.centre_real[0] && !(config.zoom_width > 0.0)))
+	{
+		cout << "Error: a deep zoom needs centre-real, centre-imaginary and zoom-width" << endl;
+		valid = false;
+	}
+	if (OUTPUT_BMP_BANDS == config.format && 0 == config.band_rows)
+	{
+		config.band_rows = DEFAULT_BAND_ROWS;
+	}
+	return valid;
+}
+
+static string trim(const string &text)
+{
+	size_t first = text.find_first_not_of(" \t\r\n");
+	if (string::npos == first)
+	{
+		return "";
+	}
+	size_t last = text.find_last_not_of(" \t\r\n");
+	return text.substr(first, last - first + 1);
+}
+
+bool read_run_config_file(const string &path, run_config &config)
+{
+	ifstream stream(path.c_str());
+	if (!stream)
+	{
+		cout << "Error: could not open the config file " << path << endl;
+		return false;
+	}
+
+	bool valid = true;
+	string line;
+	int line_number = 0;
+	while (getline(stream, line))
+	{
+		line_number++;
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty())
+		{
+			continue;
+		}
+
+		size_t equals = line.find('=');
+		string name = trim(line.substr(0, equals));
+		string value = (string::npos == equals) ? "" : trim(line.substr(equals + 1));
+		if ((string::npos == equals && !is_switch(name)) || "config" == name)
+		{
+			cout << "Error: " << path << " line " << line_number << " isn't an option" << endl;
+			valid = false;
+			continue;
+		}
+		if (!apply_option(config, name, value))
+		{
+			cout << "Error: in " << path << " line " << line_number << endl;
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+void parse_run_config(int argc, char **argv, run_config &config)
+{
+	config.status = RUN_CONFIG_RENDER;
+	vector<string> names;
+	vector<string> values;
+
+	//Split into names and values first, so the config file can be applied before
+	//the rest wherever it was given
+	for (int a = 1; a < argc; a++)
+	{
+		string arg = argv[a];
+		if (0 != arg.compare(0, 2, "--") || 2 == arg.size())
+		{
+			cout << "Error: unexpected argument " << arg << endl;
+			config.status = RUN_CONFIG_ERROR;
+			return;
+		}
+
+		string name = arg.substr(2);
+		string value;
+		size_t equals = name.find('=');
+		if (string::npos != equals)
+		{
+			value = name.substr(equals + 1);
+			name = name.substr(0, equals);
+		}
+		else if ("help" == name)
+		{
+			print_run_config_usage();
+			config.status = RUN_CONFIG_EXIT;
+			return;
+		}
+		else if (!is_switch(name))
+		{
+			if (a + 1 >= argc)
+			{
+				cout << "Error: " << arg << " needs a value" << endl;
+				config.status = RUN_CONFIG_ERROR;
+				return;
+			}
+			value = argv[++a];
+		}
+		names.push_back(name);
+		values.push_back(value);
+	}
+
+	bool valid = true;
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		if ("config" == names[n])
+		{
+			valid = read_run_config_file(values[n], config) && valid;
+		}
+	}
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		if ("config" != names[n])
+		{
+			valid = apply_option(config, names[n], values[n]) && valid;
+		}
+	}
+
+	if (!validate_run_config(config) || !valid)
+	{
+		config.status = RUN_CONFIG_ERROR;
+	}
+}
+
+void print_run_config_usage(void)
+{
+	cout << "Usage: mandel [--option value | --option=value]..." << endl
+		 << "  --config FILE             name = value lines, applied before the rest of the command line" << endl
+		 << "  --width N --height N      image size in pixels (1920 x 1080)" << endl
+		 << "  --iterations N            iteration cap (500)" << endl
+		 << "  --min-real X --max-real X --min-imaginary X" << endl
+		 << "                            window, the imaginary extent follows the aspect ratio" << endl
+		 << "  --formula F               first, third or a multibrot order N (first)" << endl
+		 << "  --parallel P              none, omp, mpi, both or subdivide (omp)" << endl
+		 << "  --threads N               OpenMP threads, 0 for the default" << endl
+		 << "  --tile-size N             shared memory tile size, 0 for the default" << endl
+		 << "  --format F                bmp, bmp-bands (streamed, see --band-rows) or bmp-tiles (bmp)" << endl
+		 << "                            all of them stop at 4 GiB (about 1.4 gigapixels)" << endl
+		 << "  --band-rows N             rows per band for bmp-bands (" << DEFAULT_BAND_ROWS << ")" << endl
+		 << "  --output PATH             image path (../resources/mandelbrot/mandel.bmp)" << endl
+		 << "  --smooth                  colour from fractional escape counts" << endl
+		 << "  --cache                   keep and reuse count buffers on disk" << endl
+		 << "  --extend-iterations N     carry the pixels at the cap on to N after the render" << endl
+		 << "  --auto-iterations         estimate the cap from a sample of the view" << endl
+		 << "  --antialias N             supersample edge pixels N x N, 0 for off" << endl
+		 << "  --batch FILE              render the views listed in FILE instead" << endl
+		 << "  --centre-real S --centre-imaginary S --zoom-width X" << endl
+		 << "                            deep zoom centre as decimal strings, and its real extent" << endl
+		 << "  --interactive             ask for the parameters on stdin" << endl
+		 << "  --help                    this list" << endl;
+}
+
+void broadcast_run_config(run_config &config)
+{
+#if defined(__unix__)
+	//Plain data and every rank runs the same build, so the bytes mean the same everywhere
+	MPI_Bcast(&config, (int)sizeof(run_config), MPI_BYTE, 0, MPI_COMM_WORLD);
+#endif
+}
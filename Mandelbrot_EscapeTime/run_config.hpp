@@ -0,0 +1,104 @@
+#pragma once
+
+#ifndef _RUN_CONFIG_HPP
+#define _RUN_CONFIG_HPP
+
+#include <string>
+
+#include "mandel_kernels.hpp"
+#include "mandel_plotter.hpp"
+
+//Longest path or centre string a run_config can hold, including the terminator
+#define RUN_CONFIG_STRING_LENGTH 1024
+
+/***************************************************************
+
+						RUN_CONFIG
+
+	Everything that decides what a run renders and how, filled
+	on rank 0 from the defaults, then a config file, then the
+	command line (each overriding the one before), and handed to
+	the other ranks in a single broadcast. It is plain data with
+	fixed size strings for that reason.
+
+	Options are --name value or --name=value on the command line
+	and name = value lines in a config file, # starts a comment.
+	Switches such as --smooth need no value on the command line.
+	--help lists them all.
+
+****************************************************************/
+
+//BMP is the only writer without OpenCV, these are the ways of producing it
+enum output_format
+{
+	OUTPUT_BMP,			//Whole count buffer in memory, then the image
+	OUTPUT_BMP_BANDS,	//Rendered and written band_rows rows at a time
+	OUTPUT_BMP_TILES	//Each tile coloured as soon as it's done, no count buffer
+};
+
+//What main should do once the config has been read
+enum run_config_status
+{
+	RUN_CONFIG_RENDER,
+	RUN_CONFIG_EXIT,		//Nothing to render, e.g. --help
+	RUN_CONFIG_ERROR
+};
+
+struct run_config
+{
+	run_config_status status;
+
+	int width;
+	int height;
+	int max_iter;
+
+	//As for the plotter's window, the imaginary extent follows from the aspect ratio
+	double min_real;
+	double max_real;
+	double min_imaginary;
+
+	mandel_formula formula;
+	int order;
+
+	parallelisation_type parallel_type;
+	int num_threads;		//0 for OpenMP's default
+	int tile_size;			//0 for the plotter's default
+
+	output_format format;
+	int band_rows;
+	char output[RUN_CONFIG_STRING_LENGTH];		//Empty for the default path
+
+	//Ask for the parameters on stdin as the original test modes did, 0 also asks
+	//for the output path after the render
+	int interactive;
+	int test_mode;
+
+	int smooth;
+	int iteration_cache;
+	int extended_max_iter;
+	int auto_max_iter;
+	int antialias_grid;
+	char batch[RUN_CONFIG_STRING_LENGTH];
+
+	//Deep zoom centre as decimal strings and the real extent, empty keeps the window
+	char centre_real[RUN_CONFIG_STRING_LENGTH];
+	char centre_imaginary[RUN_CONFIG_STRING_LENGTH];
+	double zoom_width;
+};
+
+//The values main used to have hard-coded
+void default_run_config(run_config &config);
+
+//Applies the options in argv, including any --config file, and sets status
+void parse_run_config(int argc, char **argv, run_config &config);
+
+//Applies the name = value lines in the file at path, false if any were bad
+bool read_run_config_file(const std::string &path, run_config &config);
+
+//Lists the options and what they take
+void print_run_config_usage(void);
+
+//Gives every rank rank 0's config, collective
+void broadcast_run_config(run_config &config);
+
+#endif
@@ -0,0 +1,196 @@
+/*
+	Work-stealing tile scheduler used by the shared memory render paths.
+*/
+
+#include "tile_scheduler.hpp"
+
+#include <iostream>
+#include <omp.h>
+
+using namespace std;
+
+tile_scheduler::tile_scheduler(int num_threads)
+	: m_num_threads(0)
+{
+	set_num_threads(num_threads);
+}
+
+void tile_scheduler::set_num_threads(int num_threads)
+{
+	//Default to whatever OpenMP thinks the machine has (honours OMP_NUM_THREADS)
+	if (num_threads <= 0)
+	{
+		num_threads = omp_get_max_threads();
+	}
+
+	m_queues.clear();
+
+	m_num_threads = num_threads;
+	for (int t = 0; t < m_num_threads; t++)
+	{
+		m_queues.push_back(unique_ptr<worker_queue>(new worker_queue()));
+	}
+}
+
+int tile_scheduler::get_num_threads(void)
+{
+	return m_num_threads;
+}
+
+void tile_scheduler::make_tiles(size_t first, size_t last, int width, int tile_size, vector<tile> &tiles)
+{
+	tiles.clear();
+	if (last <= first || width <= 0)
+	{
+		return;
+	}
+	if (tile_size <= 0)
+	{
+		tile_size = width;
+	}
+
+	int first_row = (int)(first / width);
+	int last_row = (int)((last - 1) / width);
+	int first_x = (int)(first % width);
+	int last_x = (int)((last - 1) % width) + 1;
+
+	//Leading partial row
+	if (0 != first_x || first_row == last_row)
+	{
+		int row_end = (first_row == last_row) ? last_x : width;
+		for (int x = first_x; x < row_end; x += tile_size)
+		{
+			tile t = { x, first_row, (x + tile_size < row_end) ? x + tile_size : row_end, first_row + 1 };
+			tiles.push_back(t);
+		}
+		first_row++;
+	}
+	if (first_row > last_row)
+	{
+		return;
+	}
+
+	//Trailing partial row is done separately unless it happens to be complete
+	int full_rows_end = (width == last_x) ? last_row + 1 : last_row;
+
+	for (int y = first_row; y < full_rows_end; y += tile_size)
+	{
+		int y_end = (y + tile_size < full_rows_end) ? y + tile_size : full_rows_end;
+		for (int x = 0; x < width; x += tile_size)
+		{
+			tile t = { x, y, (x + tile_size < width) ? x + tile_size : width, y_end };
+			tiles.push_back(t);
+		}
+	}
+
+	if (full_rows_end == last_row)
+	{
+		for (int x = 0; x < last_x; x += tile_size)
+		{
+			tile t = { x, last_row, (x + tile_size < last_x) ? x + tile_size : last_x, last_row + 1 };
+			tiles.push_back(t);
+		}
+	}
+}
+
+bool tile_scheduler::pop_local(int thread, tile &t)
+{
+	worker_queue *queue = m_queues[thread].get();
+	lock_guard<mutex> guard(queue->lock);
+	if (queue->tiles.empty())
+	{
+		return false;
+	}
+	t = queue->tiles.back();
+	queue->tiles.pop_back();
+	return true;
+}
+
+bool tile_scheduler::steal(int thread, tile &t)
+{
+	//Start with our neighbour so the threads don't all hammer thread 0
+	for (int offset = 1; offset < m_num_threads; offset++)
+	{
+		worker_queue *victim = m_queues[(thread + offset) % m_num_threads].get();
+		lock_guard<mutex> guard(victim->lock);
+		if (!victim->tiles.empty())
+		{
+			t = victim->tiles.front();
+			victim->tiles.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void tile_scheduler::reset_stats(void)
+{
+	m_stats.assign(m_num_threads, worker_stats());
+}
+
+void tile_scheduler::run(const vector<tile> &tiles, const function<void(const tile&)> &work)
+{
+	if (m_stats.size() != (size_t)m_num_threads)
+	{
+		reset_stats();
+	}
+
+	//Hand each thread a contiguous block so neighbouring tiles share a cache to start with
+	size_t num_tiles = tiles.size();
+	for (int q = 0; q < m_num_threads; q++)
+	{
+		size_t block_begin = num_tiles * q / m_num_threads;
+		size_t block_end = num_tiles * (q + 1) / m_num_threads;
+		m_queues[q]->tiles.assign(tiles.begin() + block_begin, tiles.begin() + block_end);
+	}
+
+#pragma omp parallel num_threads(m_num_threads)
+	{
+		int thread = omp_get_thread_num();
+		worker_stats &stats = m_stats[thread];
+		double start = omp_get_wtime();
+		double busy_before = stats.busy_ms;
+		tile t;
+
+		while (true)
+		{
+			bool stolen = false;
+			if (!pop_local(thread, t))
+			{
+				if (!steal(thread, t))
+				{
+					//Nothing left anywhere, no new tiles are ever added during a run
+					break;
+				}
+				stolen = true;
+			}
+
+			double tile_start = omp_get_wtime();
+			work(t);
+			stats.busy_ms += (omp_get_wtime() - tile_start) * 1000.0;
+			stats.tiles_done++;
+			if (stolen)
+			{
+				stats.tiles_stolen++;
+			}
+		}
+
+#pragma omp barrier
+		stats.idle_ms += (omp_get_wtime() - start) * 1000.0 - (stats.busy_ms - busy_before);
+	}
+}
+
+const vector<worker_stats>& tile_scheduler::get_stats(void)
+{
+	return m_stats;
+}
+
+void tile_scheduler::report(int mpi_rank)
+{
+	for (size_t t = 0; t < m_stats.size(); t++)
+	{
+		cout << "Rank: " << mpi_rank << " thread " << t
+			 << " busy " << m_stats[t].busy_ms << " [ms], idle " << m_stats[t].idle_ms << " [ms], tiles "
+			 << m_stats[t].tiles_done << " (" << m_stats[t].tiles_stolen << " stolen)" << endl;
+	}
+}
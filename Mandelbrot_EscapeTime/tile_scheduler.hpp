@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef _TILE_SCHEDULER_HPP
+#define _TILE_SCHEDULER_HPP
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/***************************************************************
+
+						TILE_SCHEDULER
+
+	Splits the image into rectangular tiles and runs them on a
+	team of OpenMP threads. Each thread starts with a contiguous
+	block of tiles in its own deque, works from the back of it and
+	steals from the front of another thread's deque once its own
+	runs dry, so threads that land on the set boundary get helped
+	by the ones that finished early.
+
+****************************************************************/
+
+//Rectangle of pixels [x_begin, x_end) x [y_begin, y_end) in image coordinates
+struct tile
+{
+	int x_begin;
+	int y_begin;
+	int x_end;
+	int y_end;
+};
+
+//What each thread did since the last reset_stats
+struct worker_stats
+{
+	double busy_ms;
+	double idle_ms;
+	long long tiles_done;
+	long long tiles_stolen;
+};
+
+class tile_scheduler
+{
+private:
+
+	struct worker_queue
+	{
+		std::mutex lock;
+		std::deque<tile> tiles;
+	};
+
+	int m_num_threads;
+
+	//One per thread, held by pointer as std::mutex can't be moved around in a vector
+	std::vector<std::unique_ptr<worker_queue> > m_queues;
+
+	std::vector<worker_stats> m_stats;
+
+	//Take from the back of our own deque
+	bool pop_local(int thread, tile &t);
+
+	//Take from the front of anyone else's
+	bool steal(int thread, tile &t);
+
+public:
+
+	//num_threads <= 0 uses every thread OpenMP will give us
+	tile_scheduler(int num_threads = 0);
+
+	//The queues' locks can't be shared or copied
+	tile_scheduler(const tile_scheduler&) = delete;
+	tile_scheduler& operator=(const tile_scheduler&) = delete;
+
+	void set_num_threads(int num_threads);
+
+	int get_num_threads(void);
+
+	//Splits the pixels [first, last) of a row-major image of the given width into
+	//tiles of at most tile_size x tile_size. Partial rows at either end become
+	//tiles of height one.
+	static void make_tiles(size_t first, size_t last, int width, int tile_size, std::vector<tile> &tiles);
+
+	//Calls work once for every tile, returns when they are all done
+	void run(const std::vector<tile> &tiles, const std::function<void(const tile&)> &work);
+
+	//The stats add up over runs until this is called
+	void reset_stats(void);
+
+	const std::vector<worker_stats>& get_stats(void);
+
+	//Per thread busy/idle breakdown since the last reset on stdout
+	void report(int mpi_rank);
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+	Reading a batch of views to render and sharing it between the MPI ranks.
+*/
+
+#include "view_batch.hpp"
+#include "image_handler.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__unix__)
+#include <mpi.h>
+#endif
+
+using namespace std;
+
+//Everything in a view_spec but the output path, so a batch goes to the other ranks
+//in one broadcast. All ranks run the same build, so the layout matches.
+struct packed_view
+{
+	double min_real;
+	double max_real;
+	double min_imaginary;
+	int width;
+	int height;
+	int max_iter;
+	int formula;
+	int order;
+};
+
+bool read_view_batch(const string &path, vector<view_spec> &views)
+{
+	ifstream stream(path.c_str());
+	if (!stream)
+	{
+		cout << "Error: could not open the batch file " << path << endl;
+		return false;
+	}
+
+	string line;
+	int line_number = 0;
+	while (getline(stream, line))
+	{
+		line_number++;
+		//Files written on Windows
+		if (!line.empty() && '\r' == line[line.size() - 1])
+		{
+			line.erase(line.size() - 1);
+		}
+		size_t first = line.find_first_not_of(" \t");
+		if (string::npos == first || '#' == line[first])
+		{
+			continue;
+		}
+
+		istringstream fields(line);
+		view_spec view;
+		string formula_name;
+		string extra;
+		fields >> view.min_real >> view.max_real >> view.min_imaginary >> view.width >> view.height
+			   >> view.max_iter >> formula_name >> view.output;
+		if (fields.fail() || (fields >> extra))
+		{
+			cout << "Error: " << path << " line " << line_number << " isn't a view, skipped" << endl;
+			continue;
+		}
+		if (view.width < 2 || view.height < 2 || view.max_iter < 1 || !(view.max_real > view.min_real))
+		{
+			cout << "Error: " << path << " line " << line_number << " has an empty view, skipped" << endl;
+			continue;
+		}
+		if (!image_handler::fits_bmp(view.width, view.height))
+		{
+			cout << "Error: " << path << " line " << line_number << " is over the 4 GiB BMP limit, skipped" << endl;
+			continue;
+		}
+		if (!parse_formula(formula_name, view.formula, view.order))
+		{
+			cout << "Error: " << path << " line " << line_number << " has an unknown formula " << formula_name
+				 << ", skipped" << endl;
+			continue;
+		}
+		views.push_back(view);
+	}
+	return true;
+}
+
+void broadcast_view_batch(vector<view_spec> &views)
+{
+#if defined(__unix__)
+	int rank = 0;
+	int size = 1;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	if (1 == size)
+	{
+		return;
+	}
+
+	int num_views = (int)views.size();
+	MPI_Bcast(&num_views, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (0 == num_views)
+	{
+		views.clear();
+		return;
+	}
+
+	vector<packed_view> packed(num_views);
+	if (0 == rank)
+	{
+		for (int v = 0; v < num_views; v++)
+		{
+			const view_spec &view = views[v];
+			packed_view entry = { view.min_real, view.max_real, view.min_imaginary, view.width, view.height,
+								  view.max_iter, (int)view.formula, view.order };
+			packed[v] = entry;
+		}
+	}
+	MPI_Bcast(&packed[0], (int)(num_views * sizeof(packed_view)), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	if (0 != rank)
+	{
+		views.resize(num_views);
+		for (int v = 0; v < num_views; v++)
+		{
+			view_spec &view = views[v];
+			view.min_real = packed[v].min_real;
+			view.max_real = packed[v].max_real;
+			view.min_imaginary = packed[v].min_imaginary;
+			view.width = packed[v].width;
+			view.height = packed[v].height;
+			view.max_iter = packed[v].max_iter;
+			view.formula = (mandel_formula)packed[v].formula;
+			view.order = packed[v].order;
+			view.output.clear();
+		}
+	}
+#endif
+}
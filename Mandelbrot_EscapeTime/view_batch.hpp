@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef _VIEW_BATCH_HPP
+#define _VIEW_BATCH_HPP
+
+#include <string>
+#include <vector>
+
+#include "mandel_kernels.hpp"
+
+/***************************************************************
+
+						VIEW_BATCH
+
+	A list of views to render in one run, read from a text file
+	with one view per line:
+
+		min_real max_real min_imaginary width height max_iter formula output
+
+	formula is "first", "third" or the order of a multibrot z^N + c.
+	As with the single render the imaginary extent follows from
+	the real one and the aspect ratio. Blank lines and lines
+	starting with # are skipped, as are (with an error) lines
+	that don't parse.
+
+	Rank 0 reads the file and broadcasts the views, everything but
+	the output path goes out as one packed struct per view.
+
+****************************************************************/
+
+struct view_spec
+{
+	double min_real;
+	double max_real;
+	double min_imaginary;
+	int width;
+	int height;
+	int max_iter;
+	mandel_formula formula;
+	int order;				//Only used for MULTIBROT
+	std::string output;		//Only kept on rank 0
+};
+
+//Appends the views in the file at path, false if it can't be opened
+bool read_view_batch(const std::string &path, std::vector<view_spec> &views);
+
+//Gives every rank rank 0's views, collective
+void broadcast_view_batch(std::vector<view_spec> &views);
+
+#endif